@@ -0,0 +1,122 @@
+// Compares the lookup table and overlap-save engines across kernel lengths, the two lookup table
+// layouts of the fixed Filter, and the fixed Filter on busy and idle input. Prints the time taken
+// per second of 3.072 MHz PDM input, so anything under 1 s keeps up with real time.
+#include "Filters.hpp"
+#include "PdmToPcm.hpp"
+#include "PdmToPcmDecimator.hpp"
+#include "Windows.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t decimationRate = 72;
+constexpr std::size_t bytesPerSecond = 3'072'000 / 8;
+
+// Feeds the input pieceLength bytes at a time, with room for outputLength outputs per call.
+template <class Engine>
+auto Time(
+    Engine& engine,
+    std::span<uint8_t const> const dataIn,
+    std::size_t const pieceLength = bytesPerSecond,
+    std::size_t const outputLength = bytesPerSecond) -> double
+{
+    std::vector<int32_t> dataOut(outputLength);
+    auto const start = std::chrono::steady_clock::now();
+    auto in = dataIn;
+    while (!in.empty())
+    {
+        auto const piece = in.first(std::min(in.size(), pieceLength));
+        in = in.subspan(engine.Process(piece, dataOut).inputConsumed_);
+    }
+    auto const stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+template <std::size_t kernelLength>
+void Compare(std::span<uint8_t const> const dataIn)
+{
+    static auto const kernel
+        = Filters::LowPass(Windows::Kaiser<kernelLength>(5.4), 0.5 / decimationRate);
+
+    PdmToPcm::LookupTableFilter lookupTable(kernel, decimationRate);
+    PdmToPcm::FftFilter fft(kernel, decimationRate);
+
+    std::printf(
+        "%6zu taps: lookup table %.3f s, fft %.3f s\n",
+        kernelLength,
+        Time(lookupTable, dataIn),
+        Time(fft, dataIn));
+}
+
+void CompareLayouts(std::span<uint8_t const> const dataIn)
+{
+    PdmToPcm::Filter stepMajor(PdmToPcm::Filter::LookupTableLayout::StepMajor);
+    PdmToPcm::Filter accessOrder(PdmToPcm::Filter::LookupTableLayout::AccessOrder);
+
+    std::printf(
+        "Filter: step major %.3f s, access order %.3f s\n",
+        Time(stepMajor, dataIn),
+        Time(accessOrder, dataIn));
+}
+
+void CompareIdle(std::span<uint8_t const> const dataIn)
+{
+    std::vector<uint8_t> const idle(dataIn.size(), 0x55);
+    PdmToPcm::Filter busyFilter;
+    PdmToPcm::Filter idleFilter;
+
+    std::printf(
+        "Filter: busy %.3f s, idle %.3f s\n",
+        Time(busyFilter, dataIn),
+        Time(idleFilter, idle));
+
+    // Idle input replayed a block at a time, then a byte at a time when the pieces or the room
+    // for output are smaller than a block.
+    constexpr std::array<std::pair<std::size_t, std::size_t>, 5> piecesAndOutputs = {{
+        {4096, 4096},
+        {32, 4096},
+        {27, 4096},
+        {4096, 3},
+        {9, 1},
+    }};
+    for (auto const& [pieceLength, outputLength] : piecesAndOutputs)
+    {
+        PdmToPcm::Filter busyPieces;
+        PdmToPcm::Filter idlePieces;
+        std::printf(
+            "Filter, %zu byte pieces, %zu outputs: busy %.3f s, idle %.3f s\n",
+            pieceLength,
+            outputLength,
+            Time(busyPieces, dataIn, pieceLength, outputLength),
+            Time(idlePieces, idle, pieceLength, outputLength));
+    }
+}
+} // namespace
+
+auto main() -> int
+{
+    std::vector<uint8_t> dataIn(bytesPerSecond);
+    uint32_t state = 1;
+    for (auto& in : dataIn)
+    {
+        state = state * 1664525U + 1013904223U;
+        in = static_cast<uint8_t>(state >> 24U);
+    }
+
+    Compare<1368>(dataIn);
+    Compare<4104>(dataIn);
+    Compare<8208>(dataIn);
+    Compare<16416>(dataIn);
+    CompareLayouts(dataIn);
+    CompareIdle(dataIn);
+
+    return 0;
+}
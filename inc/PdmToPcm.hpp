@@ -1,12 +1,21 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
 #include <span>
+#include <utility>
 
 namespace PdmToPcm
 {
+class FilterTable;
+class ReconfigurableFilter;
+class SharedLookupTable;
+
 class Filter
 {
 private:
@@ -31,7 +40,25 @@ private:
     using LookupTableInnerType = std::array<LookupTableIntegerType, lookupTableInnerDimension>;
     using LookupTableType = std::array<LookupTableInnerType, lookupTableOuterDimension>;
     static constexpr std::size_t lookupTableSize = sizeof(LookupTableType);
-    inline static LookupTableType lookupTable_ /* = */;
+    LookupTableType const* lookupTable_;
+
+    // Cut off at the decimated Nyquist frequency.
+    static constexpr double defaultCutoff_ = 0.5 / static_cast<double>(decimationRate_);
+
+    // The table every Filter uses unless given another, built on first use.
+    static auto DefaultLookupTable() -> LookupTableType const&;
+    static void BuildLookupTable(
+        LookupTableType& lookupTable,
+        double normalisedCutoffFrequency = defaultCutoff_);
+    friend class FilterTable;
+    friend class ReconfigurableFilter;
+    friend class SharedLookupTable;
+
+    explicit Filter(LookupTableType const& lookupTable);
+
+    // Switches to another table, starting every bank afresh but at the same step as the
+    // corresponding bank of other so the two produce their outputs on the same input bytes.
+    void Restart(LookupTableType const& lookupTable, Filter const& other);
 
     struct Bank
     {
@@ -42,283 +69,356 @@ private:
     static constexpr std::size_t numberOfFilterBanks_ = filterLength_ / decimationRate_;
     std::array<Bank, numberOfFilterBanks_> banks_;
 
+    // Each bank starts this many steps behind the previous one, which is also the number of input
+    // bytes between consecutive outputs.
+    static constexpr std::size_t filterBankStepStagger_
+        = numberOfLookupTableSteps_ / numberOfFilterBanks_;
+    static constexpr std::size_t bytesPerOutput_ = decimationRate_ / samplesPerLookupTableStep_;
+    static_assert(filterBankStepStagger_ == bytesPerOutput_);
+
+    using Accumulators = std::array<int32_t, numberOfFilterBanks_>;
+
+    // The same entries as LookupTableType reordered so that everything needed for one input byte
+    // is adjacent. All banks are always at the same position within their current group of
+    // filterBankStepStagger_ steps, so the outer index is that position and the innermost is the
+    // group, giving the entries for every bank in one or two cache lines rather than 19 cache
+    // lines spread across the whole table.
+    using AccessOrderEntries = std::array<LookupTableIntegerType, numberOfFilterBanks_>;
+    using AccessOrderLookupTableType = std::
+        array<std::array<AccessOrderEntries, lookupTableInnerDimension>, filterBankStepStagger_>;
+    AccessOrderLookupTableType const* accessOrderLookupTable_ = nullptr;
+
+    static auto DefaultAccessOrderLookupTable() -> AccessOrderLookupTableType const&;
+
+    // Muted or silent microphones settle into short repeating patterns. Once the input has
+    // repeated every idlePeriod_ bytes for long enough that every bank's window holds nothing
+    // else, the banks return to the same state every idleBlockLength_ bytes and produce the same
+    // outputs. Those outputs are remembered and replayed for as long as the input keeps repeating,
+    // without touching the banks. Checking one period that is a multiple of all the short ones
+    // costs a single comparison per byte and catches patterns of 1, 2, 3, 4, 6 or 12 bytes.
+    static constexpr std::size_t idlePeriod_ = 12;
+    static constexpr std::size_t idleBlockLength_ = 36;
+    static constexpr std::size_t idleBlockOutputs_ = idleBlockLength_ / bytesPerOutput_;
+    static_assert(idleBlockLength_ % idlePeriod_ == 0 && idleBlockLength_ % bytesPerOutput_ == 0);
+
+    struct IdleState
+    {
+        // The last idlePeriod_ input bytes, oldest first.
+        std::array<uint8_t, idlePeriod_> recentBytes_{};
+        std::size_t recentBytesSeen_ = 0;
+        // How many of the most recent bytes equal the byte idlePeriod_ before.
+        std::size_t run_ = 0;
+        // The most recent outputs, oldest first.
+        std::array<int32_t, idleBlockOutputs_> recentOutputs_{};
+
+        bool repeating_ = false;
+        std::array<uint8_t, idleBlockLength_> block_{};
+        std::array<int32_t, idleBlockOutputs_> blockOutputs_{};
+        // Which byte of every bytesPerOutput_ in the block finishes an output.
+        std::size_t outputOffset_ = 0;
+        // How far into the block the input has got. The banks are left where the block began
+        // until the input stops repeating.
+        std::size_t blockPosition_ = 0;
+
+        // Follows bytes from the front of input, returning how many were followed. With untilIdle
+        // it stops once the input becomes idle, but follows at least one byte if there are any.
+        auto Follow(std::span<uint8_t const> input, bool untilIdle = true) -> std::size_t;
+        void Record(std::span<int32_t const> outputs);
+        // Works out whether the input is idle, and if so the block and its outputs, from what has
+        // been followed and recorded. bytesToNextOutput is counted from the current position.
+        void Capture(std::size_t bytesToNextOutput);
+        // Leaves the idle state part way through a block. The most recent bytes and outputs
+        // follow from the block.
+        void Stop();
+        void Reset();
+    };
+
+    IdleState idle_;
+
 public:
+    // How much of each buffer a call to Process() used. Input is only ever consumed in whole bytes,
+    // so inputConsumed_ can be used directly to advance the caller's input span.
+    struct ApplyResult
+    {
+        std::size_t inputConsumed_;
+        std::size_t outputWritten_;
+    };
+
+    // Level statistics gathered as outputs are written, so a block can be gated (e.g. not encoded
+    // when silent) without another pass over it. They accumulate across calls to Process() until
+    // Reset(), which lets a block be any number of calls long.
+    struct Levels
+    {
+        // Outputs whose magnitude reaches this are counted as clipped.
+        int32_t clipLevel_ = std::numeric_limits<int32_t>::max();
+
+        int32_t peak_ = 0;
+        uint64_t sumOfSquares_ = 0;
+        std::size_t clipCount_ = 0;
+        std::size_t sampleCount_ = 0;
+
+        void Reset();
+        auto Rms() const -> double;
+        // A simple energy based voice activity decision.
+        auto Active(double rmsThreshold) const -> bool;
+    };
+
+    enum class LookupTableLayout
+    {
+        StepMajor,
+        AccessOrder,
+    };
+
     Filter();
+    // The table layout only affects speed, the output is identical.
+    explicit Filter(LookupTableLayout layout);
+    // Uses a table shared with other processes instead of the built in one. The table has to
+    // outlive the Filter.
+    explicit Filter(SharedLookupTable const& lookupTable);
+    // Uses a table with a different cutoff. The table has to outlive the Filter.
+    explicit Filter(FilterTable const& lookupTable);
     ~Filter() = default;
     Filter(Filter const&) = delete;
     Filter(Filter&&) = delete;
     void operator=(Filter const&) = delete;
     void operator=(Filter&&) = delete;
     auto Apply(std::span<uint8_t> dataIn, std::span<int32_t> dataOut) -> std::size_t;
+    auto Process(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut) -> ApplyResult;
+    auto Process(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut, Levels& levels)
+        -> ApplyResult;
+
+    // Fixed size blocks, e.g. straight from a DMA buffer. Every input block produces exactly one
+    // full output block. Idle input is replayed here too, from the block after the one that
+    // leaves it idle. Blocks can be metered in the same way as Process().
+    template <std::size_t outputLength>
+    using InputBlock = std::array<uint8_t, outputLength * bytesPerOutput_>;
+    template <std::size_t outputLength>
+    using OutputBlock = std::array<int32_t, outputLength>;
+
+    template <std::size_t outputLength>
+    void Apply(InputBlock<outputLength> const& dataIn, OutputBlock<outputLength>& dataOut);
+    template <std::size_t outputLength>
+    void Apply(
+        InputBlock<outputLength> const& dataIn,
+        OutputBlock<outputLength>& dataOut,
+        Levels& levels);
+
+private:
+    template <bool metered>
+    class LevelAccumulator;
+
+    template <bool metered, std::size_t chunk, std::size_t... slots>
+    void ApplyChunk(
+        uint8_t const* dataIn,
+        int32_t* dataOut,
+        Accumulators& sums,
+        LevelAccumulator<metered>& meter,
+        std::index_sequence<slots...> /*unused*/) const;
+
+    template <bool metered, std::size_t... chunks>
+    void ApplyChunks(
+        uint8_t const* dataIn,
+        int32_t* dataOut,
+        Accumulators& sums,
+        LevelAccumulator<metered>& meter,
+        std::index_sequence<chunks...> /*unused*/) const;
+
+    template <bool metered, std::size_t outputLength>
+    void ApplyImpl(
+        InputBlock<outputLength> const& dataIn,
+        OutputBlock<outputLength>& dataOut,
+        Levels* levels);
+
+    template <bool metered>
+    auto ProcessImpl(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut, Levels* levels)
+        -> ApplyResult;
+
+    // Replays the idle block's outputs for as much of the input as keeps repeating it.
+    auto ReplayIdle(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut) -> ApplyResult;
+    // Brings the banks level with the input once it stops repeating part way through a block.
+    void CatchUpIdle();
+    auto BytesToNextOutput() const -> std::size_t;
+
+    template <bool metered>
+    auto ProcessStepMajor(
+        std::span<uint8_t const> dataIn,
+        std::span<int32_t> dataOut,
+        Levels* levels) -> ApplyResult;
+
+    template <bool metered>
+    auto ProcessAccessOrder(
+        std::span<uint8_t const> dataIn,
+        std::span<int32_t> dataOut,
+        Levels* levels) -> ApplyResult;
 };
-} // namespace PdmToPcm
 
-// #pragma once
-
-// #include "KaiserWindow.hpp"
-
-// namespace PdmToPcm
-// {
-
-// // template <class OutputType, size_t filterLengthDiv8>
-// // constexpr auto FindScaleToFitOutputType(
-// //     std::array<double, filterLengthDiv8 * 8> const& filterKernel) -> double
-// // {
-// //     double maxLutStepSum = 0.0;
-// //     for (size_t lutStep = 0; lutStep < filterLengthDiv8; ++lutStep)
-// //     {
-// //         double lutStepSum = 0.0;
-// //         for (size_t shift = 0; shift < 8; ++shift)
-// //         {
-// //             constexpr double dcOffset = 0.5;
-// //             constexpr double maxFilterInput = 1 - dcOffset;
-
-// //             size_t const filterStep = 8 * lutStep + shift;
-
-// //             lutStepSum += maxFilterInput * filterKernel[filterStep];
-// //         }
-
-// //         if (lutStepSum > maxLutStepSum)
-// //         {
-// //             maxLutStepSum = lutStepSum;
-// //         }
-// //     }
-// //     constexpr auto maxOutputValue =
-// static_cast<double>(std::numeric_limits<OutputType>::max());
-
-// //     return maxOutputValue / maxLutStepSum;
-// // }
-
-// template <class OutputType, size_t filterLengthDiv8>
-// constexpr auto CreateKernelLookupTable(double const beta, bool const msb = true)
-//     -> std::array<std::array<OutputType, 256>, filterLengthDiv8>
-// {
-//     static_assert(std::is_integral_v<OutputType>);
-//     static_assert(std::is_signed_v<OutputType>);
-
-//     constexpr size_t filterLength = filterLengthDiv8 * 8;
-//     auto const filterKernel = CreateKernel<filterLength>(beta);
-
-//     double maxLutStepSum = 0.0;
-//     for (size_t lutStep = 0; lutStep < filterLengthDiv8; ++lutStep)
-//     {
-//         double lutStepSum = 0.0;
-//         for (size_t shift = 0; shift < 8; ++shift)
-//         {
-//             constexpr double dcOffset = 0.5;
-//             constexpr double maxFilterInput = 1 - dcOffset;
-
-//             size_t const filterStep = 8 * lutStep + shift;
-
-//             lutStepSum += maxFilterInput * filterKernel[filterStep];
-//         }
-
-//         if (lutStepSum > maxLutStepSum)
-//         {
-//             maxLutStepSum = lutStepSum;
-//         }
-//     }
-//     constexpr auto maxOutputValue = static_cast<double>(std::numeric_limits<OutputType>::max());
-//     double const scaleToFitOutputType = maxOutputValue / maxLutStepSum;
-
-//     // double const scaleToFitOutputType
-//     //     = FindScaleToFitOutputType<OutputType, filterLengthDiv8>(filterKernel);
-
-//     std::array<std::array<OutputType, 256>, filterLengthDiv8> lut{};
-//     for (size_t lutStep = 0; lutStep < filterLengthDiv8; ++lutStep)
-//     {
-//         for (size_t pdm = 0; pdm < 256; ++pdm)
-//         {
-//             double lutStepSum = 0.0;
-//             for (size_t shift = 0; shift < 8; ++shift)
-//             {
-//                 size_t const bitIdx = msb ? (7 - shift) : shift;
-
-//                 constexpr double dcOffset = 0.5;
-//                 double const filterInput = ((pdm >> bitIdx) & 1) - dcOffset;
-
-//                 size_t const filterStep = 8 * lutStep + shift;
-
-//                 lutStepSum += filterInput * filterKernel[filterStep];
-//             }
-
-//             lut[lutStep][pdm] = static_cast<OutputType>(std::clamp(
-//                 lutStepSum * scaleToFitOutputType,
-//                 static_cast<double>(std::numeric_limits<OutputType>::min()),
-//                 static_cast<double>(std::numeric_limits<OutputType>::max())));
-//         }
-//     }
-
-//     return lut;
-// }
-
-// // static constexpr double Rolloff3db(double const sampleFrequency)
-// // {
-// //     return KaiserWindow::RollOff3dBNormalised(numberOfTaps_, beta_) * sampleFrequency;
-// // }
-
-// // static constexpr double RolloffNull(double const sampleFrequency)
-// // {
-// //     return KaiserWindow::RollOffNullNormalised(numberOfTaps_, beta_) * sampleFrequency;
-// // }
-
-// template <
-//     typename OutputIntegerType,
-//     std::size_t numberOfTaps_,
-//     std::size_t decimationRate_,
-//     std::size_t outputLength_,
-//     int beta1000_>
-// class Filter
-// {
-// private:
-//     static constexpr double beta_ = static_cast<double>(beta1000_) / 1000.0;
-
-//     static constexpr size_t numberOfFilterBanks_{numberOfTaps_ / decimationRate_};
-//     static_assert(
-//         numberOfFilterBanks_ * decimationRate_ == numberOfTaps_,
-//         "numberOfTaps_ must be a multiple of decimationRate!");
-
-//     struct Bank
-//     {
-//         size_t step_;
-//         OutputIntegerType accumulator_;
-//     };
-
-//     std::array<Bank, numberOfFilterBanks_> banks_{};
-
-//     static constexpr size_t tapsPerStep_{8U};
-//     static constexpr size_t numberOfSteps_{numberOfTaps_ / tapsPerStep_};
-//     static_assert((1 << tapsPerStep_) == 256);
-//     static_assert(numberOfTaps_ % tapsPerStep_ == 0, "numberOfTaps_ must be a multiple of 8!");
-//     static_assert(decimationRate_ % tapsPerStep_ == 0, "decimationRate must be a multiple of
-//     8!");
-
-//     using LutIntegerType = int16_t;
-//     using LutType = std::array<std::array<LutIntegerType, 256>, numberOfSteps_>;
-
-//     inline static LutType lut_
-//         = KaiserWindow::CreateKernelLookupTable<LutIntegerType, numberOfSteps_>(beta_);
-
-// public:
-//     Filter()
-//     {
-//         constexpr size_t filterBankStepStagger = numberOfSteps_ / numberOfFilterBanks_;
-
-//         for (size_t i = 0; i < numberOfFilterBanks_; ++i)
-//         {
-//             banks_[i].step_ = (numberOfSteps_ - (i * filterBankStepStagger)) % numberOfSteps_;
-//             banks_[i].accumulator_ = 0;
-//         }
-//     }
-
-//     Filter(Filter const&) = delete;
-//     Filter(Filter&&) = delete;
-//     void operator=(Filter const&) = delete;
-//     void operator=(Filter&&) = delete;
-
-//     static constexpr size_t inputLength_ = (outputLength_ * decimationRate_) / tapsPerStep_;
-//     using InputType = std::array<uint8_t, inputLength_>;
-//     using OutputType = std::array<OutputIntegerType, outputLength_>;
-
-//     void ApplySlow(InputType const& dataIn, OutputType& dataOut)
-//     {
-//         // So we don't need to worry about going off the end of dataOut.
-//         static_assert((inputLength_ * numberOfFilterBanks_) / numberOfSteps_ == outputLength_);
-
-//         auto outIter = dataOut.begin();
-
-//         for (auto const in : dataIn)
-//         {
-//             for (auto& bank : banks_)
-//             {
-//                 bank.accumulator_ += lut_[bank.step_][in];
-//                 ++bank.step_;
-//                 if (bank.step_ == numberOfSteps_)
-//                 {
-//                     (*outIter) = bank.accumulator_;
-//                     ++outIter;
-//                     bank.step_ = 0;
-//                     bank.accumulator_ = 0;
-//                 }
-//             }
-//         }
-//     }
-
-//     void Apply(InputType const& dataIn, OutputType& dataOut)
-//     {
-//         constexpr size_t loopUnrollMultiple = 5;
-//         static_assert(numberOfFilterBanks_ == 4);
-//         static_assert(numberOfSteps_ % loopUnrollMultiple == 0);
-//         static_assert(inputLength_ > loopUnrollMultiple);
-
-//         size_t inIdx = 0;
-//         size_t outIdx = 0;
-//         auto step0 = banks_[0].step_;
-//         auto step1 = banks_[1].step_;
-//         auto step2 = banks_[2].step_;
-//         auto step3 = banks_[3].step_;
-//         auto sum0 = banks_[0].accumulator_;
-//         auto sum1 = banks_[1].accumulator_;
-//         auto sum2 = banks_[2].accumulator_;
-//         auto sum3 = banks_[3].accumulator_;
-
-//         while (inIdx < inputLength_)
-//         {
-//             auto const data0 = dataIn[inIdx];
-//             auto const data1 = dataIn[inIdx + 1];
-//             auto const data2 = dataIn[inIdx + 2];
-//             auto const data3 = dataIn[inIdx + 3];
-//             auto const data4 = dataIn[inIdx + 4];
-//             inIdx += loopUnrollMultiple;
-
-//             sum0 += lut_[step0][data0] + lut_[step0 + 1][data1] + lut_[step0 + 2][data2]
-//                   + lut_[step0 + 3][data3] + lut_[step0 + 4][data4];
-//             sum1 += lut_[step1][data0] + lut_[step1 + 1][data1] + lut_[step1 + 2][data2]
-//                   + lut_[step1 + 3][data3] + lut_[step1 + 4][data4];
-//             sum2 += lut_[step2][data0] + lut_[step2 + 1][data1] + lut_[step2 + 2][data2]
-//                   + lut_[step2 + 3][data3] + lut_[step2 + 4][data4];
-//             sum3 += lut_[step3][data0] + lut_[step3 + 1][data1] + lut_[step3 + 2][data2]
-//                   + lut_[step3 + 3][data3] + lut_[step3 + 4][data4];
-
-//             step0 += loopUnrollMultiple;
-//             step1 += loopUnrollMultiple;
-//             step2 += loopUnrollMultiple;
-//             step3 += loopUnrollMultiple;
-
-//             if (step0 == numberOfSteps_)
-//             {
-//                 dataOut[outIdx++] = sum0;
-//                 step0 = 0;
-//                 sum0 = 0;
-//             }
-//             if (step1 == numberOfSteps_)
-//             {
-//                 dataOut[outIdx++] = sum1;
-//                 step1 = 0;
-//                 sum1 = 0;
-//             }
-//             if (step2 == numberOfSteps_)
-//             {
-//                 dataOut[outIdx++] = sum2;
-//                 step2 = 0;
-//                 sum2 = 0;
-//             }
-//             if (step3 == numberOfSteps_)
-//             {
-//                 dataOut[outIdx++] = sum3;
-//                 step3 = 0;
-//                 sum3 = 0;
-//             }
-//         }
-
-//         banks_[0].step_ = step0;
-//         banks_[1].step_ = step1;
-//         banks_[2].step_ = step2;
-//         banks_[3].step_ = step3;
-//         banks_[0].accumulator_ = sum0;
-//         banks_[1].accumulator_ = sum1;
-//         banks_[2].accumulator_ = sum2;
-//         banks_[3].accumulator_ = sum3;
-//     }
-// };
-// } // namespace PdmToPcm
\ No newline at end of file
+// Gathers Filter::Levels in locals for the duration of a call rather than updating them for
+// every output. Compiles away entirely when not metered.
+template <bool metered>
+class Filter::LevelAccumulator
+{
+    int64_t clipLevel_ = 0;
+    int64_t peak_ = 0;
+    uint64_t sumOfSquares_ = 0;
+    std::size_t clipCount_ = 0;
+
+public:
+    explicit LevelAccumulator(Levels const* const levels)
+    {
+        if constexpr (metered)
+        {
+            clipLevel_ = levels->clipLevel_;
+        }
+    }
+
+    void Add(int32_t const sample)
+    {
+        if constexpr (metered)
+        {
+            auto const magnitude = std::abs(static_cast<int64_t>(sample));
+            peak_ = std::max(peak_, magnitude);
+            sumOfSquares_ += static_cast<uint64_t>(magnitude * magnitude);
+            clipCount_ += magnitude >= clipLevel_ ? 1 : 0;
+        }
+    }
+
+    void Finish(Levels* const levels, std::size_t const sampleCount) const
+    {
+        if constexpr (metered)
+        {
+            levels->peak_ = std::max(levels->peak_, static_cast<int32_t>(peak_));
+            levels->sumOfSquares_ += sumOfSquares_;
+            levels->clipCount_ += clipCount_;
+            levels->sampleCount_ += sampleCount;
+        }
+    }
+};
+// Runs one output's worth of input (a chunk) through every bank. Slot k of sums holds the bank
+// that was at step (k * filterBankStepStagger_) at the start of the block, so at a known chunk
+// within the block every table row and the slot that finishes are constants.
+template <bool metered, std::size_t chunk, std::size_t... slots>
+void Filter::ApplyChunk(
+    uint8_t const* const dataIn,
+    int32_t* const dataOut,
+    Accumulators& sums,
+    LevelAccumulator<metered>& meter,
+    std::index_sequence<slots...> /*unused*/) const
+{
+    constexpr std::array<std::size_t, numberOfFilterBanks_> firstSteps
+        = {(filterBankStepStagger_ * ((slots + chunk) % numberOfFilterBanks_))...};
+
+    auto const& lookupTable = *lookupTable_;
+    for (std::size_t i = 0; i < bytesPerOutput_; ++i)
+    {
+        auto const in = dataIn[i];
+        ((sums[slots] += lookupTable[firstSteps[slots] + i][in]), ...);
+    }
+
+    constexpr std::size_t finished
+        = (2 * numberOfFilterBanks_ - 1 - (chunk % numberOfFilterBanks_)) % numberOfFilterBanks_;
+    (*dataOut) = sums[finished];
+    meter.Add(sums[finished]);
+    sums[finished] = 0;
+}
+
+template <bool metered, std::size_t... chunks>
+void Filter::ApplyChunks(
+    uint8_t const* const dataIn,
+    int32_t* const dataOut,
+    Accumulators& sums,
+    LevelAccumulator<metered>& meter,
+    std::index_sequence<chunks...> /*unused*/) const
+{
+    (ApplyChunk<metered, chunks>(
+         dataIn + chunks * bytesPerOutput_,
+         dataOut + chunks,
+         sums,
+         meter,
+         std::make_index_sequence<numberOfFilterBanks_>{}),
+     ...);
+}
+
+template <std::size_t outputLength>
+void Filter::Apply(InputBlock<outputLength> const& dataIn, OutputBlock<outputLength>& dataOut)
+{
+    ApplyImpl<false>(dataIn, dataOut, nullptr);
+}
+
+template <std::size_t outputLength>
+void Filter::Apply(
+    InputBlock<outputLength> const& dataIn,
+    OutputBlock<outputLength>& dataOut,
+    Levels& levels)
+{
+    ApplyImpl<true>(dataIn, dataOut, &levels);
+}
+
+template <bool metered, std::size_t outputLength>
+void Filter::ApplyImpl(
+    InputBlock<outputLength> const& dataIn,
+    OutputBlock<outputLength>& dataOut,
+    Levels* const levels)
+{
+    auto const phase
+        = static_cast<std::size_t>(std::distance(lookupTable_->cbegin(), banks_[0].step_))
+        % filterBankStepStagger_;
+
+    // Idle input is replayed by Process(). Otherwise a previous call to Process() stopped part way
+    // between outputs. Either way the block still produces exactly outputLength outputs, but the
+    // last few bytes may come after the last output so they have to be fed through separately.
+    if (idle_.repeating_ || phase != 0)
+    {
+        ApplyResult result{};
+        if constexpr (metered)
+        {
+            result = Process(dataIn, dataOut, *levels);
+        }
+        else
+        {
+            result = Process(dataIn, dataOut);
+        }
+        std::array<int32_t, 1> unused{};
+        Process(std::span(dataIn).subspan(result.inputConsumed_), unused);
+        return;
+    }
+
+    Accumulators sums{};
+    for (auto const& bank : banks_)
+    {
+        auto const step
+            = static_cast<std::size_t>(std::distance(lookupTable_->cbegin(), bank.step_));
+        sums[step / filterBankStepStagger_] = bank.accumulator_;
+    }
+
+    // Every numberOfFilterBanks_ chunks the banks are back where they started, so whole periods
+    // can share one fully unrolled body.
+    constexpr std::size_t chunksPerPeriod = numberOfFilterBanks_;
+    constexpr std::size_t numberOfPeriods = outputLength / chunksPerPeriod;
+    constexpr std::size_t remainingChunks = outputLength % chunksPerPeriod;
+
+    auto const* in = dataIn.data();
+    auto* out = dataOut.data();
+    LevelAccumulator<metered> meter(levels);
+    for (std::size_t period = 0; period < numberOfPeriods; ++period)
+    {
+        ApplyChunks(in, out, sums, meter, std::make_index_sequence<chunksPerPeriod>{});
+        in += chunksPerPeriod * bytesPerOutput_;
+        out += chunksPerPeriod;
+    }
+    ApplyChunks(in, out, sums, meter, std::make_index_sequence<remainingChunks>{});
+    meter.Finish(levels, outputLength);
+
+    for (std::size_t slot = 0; slot < numberOfFilterBanks_; ++slot)
+    {
+        auto const step = filterBankStepStagger_ * ((slot + outputLength) % numberOfFilterBanks_);
+        banks_.at(slot).step_
+            = std::next(lookupTable_->cbegin(), static_cast<std::ptrdiff_t>(step));
+        banks_.at(slot).accumulator_ = sums.at(slot);
+    }
+
+    // The block ends on an output, so if it leaves the input idle the next block is replayed.
+    idle_.Follow(dataIn, false);
+    idle_.Record(dataOut);
+    idle_.Capture(bytesPerOutput_);
+}
+} // namespace PdmToPcm
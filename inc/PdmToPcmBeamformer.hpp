@@ -0,0 +1,68 @@
+#pragma once
+
+#include "LookupTable.hpp"
+#include "PdmToPcm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace PdmToPcm
+{
+// Delay-and-sum beamforming done inside the decimator. Each channel is delayed by its own number
+// of PDM samples and the channels are summed in the filter banks' accumulators, so a whole array
+// produces one beamformed stream without decimating every channel separately.
+//
+// Whole bytes of delay are taken by delaying the channel's input. The rest, including any
+// fraction of a sample, is taken by the channel's own lookup table, built from the low pass
+// prototype shifted by that amount. Only the differences between the delays matter, so the
+// smallest delay is taken as zero. The output is the sum of the channels, so it grows with their
+// number.
+class BeamformingFilter
+{
+private:
+    // One row per step per channel, the channels of a step adjacent.
+    std::vector<LookupTable::Row> lookupTable_;
+    std::size_t numberOfChannels_;
+
+    struct Bank
+    {
+        std::vector<LookupTable::Row>::const_iterator step_;
+        int32_t accumulator_;
+    };
+
+    std::vector<Bank> banks_;
+
+    // Holds the last few bytes of a channel's input, as many as it is delayed by. Starts out full
+    // of idle (0x55) bytes so the delayed channels start out silent rather than at full scale.
+    struct DelayLine
+    {
+        std::vector<uint8_t> bytes_;
+        std::size_t next_ = 0;
+
+        auto Push(uint8_t in) -> uint8_t;
+    };
+
+    std::vector<DelayLine> delayLines_;
+    std::vector<uint8_t> delayed_;
+
+public:
+    // The window is that of the low pass prototype and sets the kernel length, which must be a
+    // multiple of decimationRate, which in turn must be a multiple of 8. There is one delay per
+    // channel, in PDM samples. Throws std::invalid_argument if any of these don't hold.
+    BeamformingFilter(
+        std::span<double const> window,
+        double normalisedCutoffFrequency,
+        std::size_t decimationRate,
+        std::span<double const> delays);
+    ~BeamformingFilter() = default;
+    BeamformingFilter(BeamformingFilter const&) = delete;
+    BeamformingFilter(BeamformingFilter&&) = delete;
+    void operator=(BeamformingFilter const&) = delete;
+    void operator=(BeamformingFilter&&) = delete;
+
+    // Takes one span per channel, all the same length.
+    auto Process(std::span<std::span<uint8_t const> const> dataIn, std::span<int32_t> dataOut)
+        -> Filter::ApplyResult;
+};
+} // namespace PdmToPcm
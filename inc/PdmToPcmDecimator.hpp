@@ -0,0 +1,112 @@
+#pragma once
+
+#include "LookupTable.hpp"
+#include "PdmToPcm.hpp"
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace PdmToPcm
+{
+// The same lookup table engine as Filter but for any kernel given at runtime. The kernel length
+// must be a multiple of decimationRate, which in turn must be a multiple of 8, or the constructor
+// throws std::invalid_argument. Its cost per input byte grows linearly with the kernel length.
+class LookupTableFilter
+{
+private:
+    std::vector<LookupTable::Row> lookupTable_;
+
+    struct Bank
+    {
+        std::vector<LookupTable::Row>::const_iterator step_;
+        int32_t accumulator_;
+    };
+
+    std::vector<Bank> banks_;
+
+public:
+    LookupTableFilter(std::span<double const> kernel, std::size_t decimationRate);
+    // Scales the table by scale rather than the largest that fits, e.g. to put several filters'
+    // outputs in the same units. See LookupTable::Scale().
+    LookupTableFilter(std::span<double const> kernel, std::size_t decimationRate, double scale);
+    ~LookupTableFilter() = default;
+    LookupTableFilter(LookupTableFilter const&) = delete;
+    LookupTableFilter(LookupTableFilter&&) = delete;
+    void operator=(LookupTableFilter const&) = delete;
+    void operator=(LookupTableFilter&&) = delete;
+    auto Process(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut)
+        -> Filter::ApplyResult;
+};
+
+// Overlap-save decimation for very long kernels. The input is collected into blocks that are
+// filtered in the frequency domain, so the cost per input byte only grows with the log of the
+// kernel length. Outputs match LookupTableFilter built from the same kernel to within rounding,
+// but are only produced once a whole pair of blocks has arrived. The kernel length and
+// decimationRate are checked as for LookupTableFilter.
+class FftFilter
+{
+private:
+    std::size_t decimationRate_;
+    std::size_t historyLength_;
+    std::size_t blockLength_;
+    std::size_t fold_;
+
+    std::vector<std::complex<double>> twiddles_;
+    std::vector<std::complex<double>> foldedTwiddles_;
+    std::vector<std::complex<double>> kernelSpectrum_;
+    std::vector<std::complex<double>> spectrum_;
+    std::vector<std::complex<double>> folded_;
+
+    // The last historyLength_ samples of the previous pair of blocks followed by the current pair.
+    std::vector<double> samples_;
+    std::size_t blockFill_ = 0;
+
+    std::vector<int32_t> pending_;
+    std::size_t pendingIndex_;
+
+    void ApplyBlocks();
+
+public:
+    FftFilter(std::span<double const> kernel, std::size_t decimationRate);
+    ~FftFilter() = default;
+    FftFilter(FftFilter const&) = delete;
+    FftFilter(FftFilter&&) = delete;
+    void operator=(FftFilter const&) = delete;
+    void operator=(FftFilter&&) = delete;
+    auto Process(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut)
+        -> Filter::ApplyResult;
+};
+
+// Picks the cheaper engine for a kernel: the lookup table up to fftTapThreshold taps and
+// overlap-save above it.
+class Decimator
+{
+private:
+    using Engine = std::variant<LookupTableFilter, FftFilter>;
+    Engine engine_;
+
+    static auto CreateEngine(
+        std::span<double const> kernel,
+        std::size_t decimationRate,
+        std::size_t fftTapThreshold) -> Engine;
+
+public:
+    static constexpr std::size_t defaultFftTapThreshold_ = 8192;
+
+    Decimator(
+        std::span<double const> kernel,
+        std::size_t decimationRate,
+        std::size_t fftTapThreshold = defaultFftTapThreshold_);
+    ~Decimator() = default;
+    Decimator(Decimator const&) = delete;
+    Decimator(Decimator&&) = delete;
+    void operator=(Decimator const&) = delete;
+    void operator=(Decimator&&) = delete;
+    auto Process(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut)
+        -> Filter::ApplyResult;
+    auto UsesFft() const -> bool;
+};
+} // namespace PdmToPcm
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "PdmToPcm.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace PdmToPcm
+{
+// Produces two output rates from one pass over the input, e.g. a 48 kHz stream alongside a 16 kHz
+// stream. The input is only decoded once by the lookup table Filter, whose output is both
+// returned as is and decimated a further secondStageDecimationRate_ times by a short FIR filter.
+// The second stage runs at the already decimated rate, so it costs a small fraction of the first.
+class MultiRateFilter
+{
+public:
+    static constexpr std::size_t secondStageDecimationRate_ = 3;
+
+private:
+    static constexpr std::size_t secondStageLength_ = 96;
+    static_assert(secondStageLength_ % secondStageDecimationRate_ == 0);
+
+    // The second stage coefficients are fixed point with this many fractional bits.
+    static constexpr int secondStageFractionalBits_ = 15;
+    using SecondStageKernelType = std::array<int32_t, secondStageLength_>;
+    static auto SecondStageKernel() -> SecondStageKernelType const&;
+
+    Filter firstStage_;
+
+    // Every sample is written twice, secondStageLength_ apart, so the most recent
+    // secondStageLength_ samples are always contiguous and the FIR never has to wrap.
+    std::array<int32_t, 2 * secondStageLength_> history_{};
+    std::size_t historyIndex_ = 0;
+    std::size_t samplesSinceOutput_ = 0;
+
+public:
+    struct ApplyResult
+    {
+        std::size_t inputConsumed_;
+        std::size_t outputWritten_;
+        std::size_t decimatedOutputWritten_;
+    };
+
+    MultiRateFilter() = default;
+    ~MultiRateFilter() = default;
+    MultiRateFilter(MultiRateFilter const&) = delete;
+    MultiRateFilter(MultiRateFilter&&) = delete;
+    void operator=(MultiRateFilter const&) = delete;
+    void operator=(MultiRateFilter&&) = delete;
+
+    // Stops as soon as either output is full. dataOut receives the Filter rate output and
+    // dataOutDecimated the same signal decimated by secondStageDecimationRate_.
+    auto Process(
+        std::span<uint8_t const> dataIn,
+        std::span<int32_t> dataOut,
+        std::span<int32_t> dataOutDecimated) -> ApplyResult;
+};
+} // namespace PdmToPcm
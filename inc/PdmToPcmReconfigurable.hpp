@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PdmToPcm.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace PdmToPcm
+{
+// A Filter lookup table with a cutoff other than the decimated Nyquist frequency, e.g. a narrower
+// band for voice. Building one takes a while and allocates nothing, so it is best done up front.
+class FilterTable
+{
+private:
+    Filter::LookupTableType table_{};
+
+public:
+    explicit FilterTable(double normalisedCutoffFrequency);
+    ~FilterTable() = default;
+    FilterTable(FilterTable const&) = delete;
+    FilterTable(FilterTable&&) = delete;
+    void operator=(FilterTable const&) = delete;
+    void operator=(FilterTable&&) = delete;
+
+    auto Table() const -> Filter::LookupTableType const&;
+};
+
+// A Filter whose lookup table can be changed while it runs. Reconfigure() may be called from any
+// thread, it just publishes the new table through an atomic pointer. The thread calling Process()
+// picks it up at the start of its next call and starts running the new table alongside the old
+// one. Once the new table has a whole kernel's worth of input behind it the output crossfades
+// linearly from the old table to the new. Neither side takes a lock or allocates.
+//
+// Every table passed in has to outlive the filter, or at least until a later table has taken
+// over. A table published while a crossfade is under way waits for it to finish, and only the most
+// recently published one is used.
+class ReconfigurableFilter
+{
+private:
+    std::array<Filter, 2> filters_;
+    std::size_t active_ = 0;
+
+    std::atomic<Filter::LookupTableType const*> requested_ = nullptr;
+
+    enum class State
+    {
+        Steady,
+        Switching,
+    };
+
+    State state_ = State::Steady;
+    std::size_t crossfadeLength_;
+    // Outputs produced by the incoming filter since it was started.
+    std::size_t switchProgress_ = 0;
+
+    // The incoming filter's output is gathered here, in pieces of up to this many outputs.
+    std::array<int32_t, 64> incomingOut_{};
+
+    auto Active() -> Filter&;
+    auto Incoming() -> Filter&;
+    void Publish(Filter::LookupTableType const& lookupTable);
+    auto Switch(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut)
+        -> Filter::ApplyResult;
+
+public:
+    // The number of outputs the crossfade takes, 256 is 6 ms at 42.7 kHz. A length of 0 or 1
+    // switches straight over once the new table has a whole kernel's worth of input.
+    static constexpr std::size_t defaultCrossfadeLength_ = 256;
+
+    explicit ReconfigurableFilter(std::size_t crossfadeLength = defaultCrossfadeLength_);
+    ~ReconfigurableFilter() = default;
+    ReconfigurableFilter(ReconfigurableFilter const&) = delete;
+    ReconfigurableFilter(ReconfigurableFilter&&) = delete;
+    void operator=(ReconfigurableFilter const&) = delete;
+    void operator=(ReconfigurableFilter&&) = delete;
+
+    void Reconfigure(FilterTable const& lookupTable);
+    // Back to the built in table.
+    void ReconfigureDefault();
+
+    auto Process(std::span<uint8_t const> dataIn, std::span<int32_t> dataOut)
+        -> Filter::ApplyResult;
+    // Whether the filter is part way through switching tables. Only for the thread calling
+    // Process().
+    auto Switching() const -> bool;
+};
+} // namespace PdmToPcm
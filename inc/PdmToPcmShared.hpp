@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PdmToPcm.hpp"
+#include <cstddef>
+#include <string>
+
+namespace PdmToPcm
+{
+// A Filter lookup table in a named, read only shared memory segment so that every process on a
+// host maps the same copy. The first process to open a name builds the table, the rest map it and
+// wait for it to be ready. The segment is backed by 2 MB huge pages when hugetlbfs is mounted at
+// /dev/hugepages and has pages free, otherwise by ordinary POSIX shared memory. Once a process has
+// fallen back to the ordinary segment every later one does too, so all of them share one copy.
+//
+// The segment starts with a header describing the filter the table was built for, a table built
+// for a different configuration is refused with std::runtime_error. Operating system failures are
+// reported with std::system_error.
+class SharedLookupTable
+{
+private:
+    void* mapping_ = nullptr;
+    std::size_t mappingSize_ = 0;
+    bool hugePages_ = false;
+
+public:
+    // name must begin with a '/' and contain no others, as for shm_open.
+    explicit SharedLookupTable(std::string const& name);
+    ~SharedLookupTable();
+    SharedLookupTable(SharedLookupTable const&) = delete;
+    SharedLookupTable(SharedLookupTable&&) = delete;
+    void operator=(SharedLookupTable const&) = delete;
+    void operator=(SharedLookupTable&&) = delete;
+
+    auto Table() const -> Filter::LookupTableType const&;
+    auto UsesHugePages() const -> bool;
+
+    // Removes the segment name, processes that already have it mapped are unaffected.
+    static void Remove(std::string const& name);
+};
+} // namespace PdmToPcm
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PdmToPcm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace PdmToPcm
+{
+// Converts a PDM byte stream that arrives piecemeal (e.g. from an event loop callback) into fixed
+// size blocks of PCM. Input is handed over with Feed() and full blocks are drawn with Next() until
+// it returns std::nullopt, at which point all of the fed input has been consumed. The input is read
+// in place and never copied, so the fed span must stay valid until then.
+//
+// The block being filled and the unconsumed part of the input are both kept between calls, so a
+// partially filled block and a partially consumed input span are picked up exactly where they
+// were left without any extra buffering or threads.
+class BlockStream
+{
+private:
+    Filter& filter_;
+    std::span<int32_t> block_;
+    std::size_t blockFilled_ = 0;
+    std::span<uint8_t const> input_;
+    std::size_t inputConsumed_ = 0;
+
+public:
+    BlockStream(Filter& filter, std::span<int32_t> block);
+    ~BlockStream() = default;
+    BlockStream(BlockStream const&) = delete;
+    BlockStream(BlockStream&&) = delete;
+    void operator=(BlockStream const&) = delete;
+    void operator=(BlockStream&&) = delete;
+
+    // Any input left over from the previous Feed() is discarded, see Remaining().
+    void Feed(std::span<uint8_t const> dataIn);
+    auto Next() -> std::optional<std::span<int32_t const>>;
+
+    // The part of the last fed span that has not been consumed yet.
+    auto Remaining() const -> std::span<uint8_t const>;
+    // The total number of input bytes consumed since construction.
+    auto InputConsumed() const -> std::size_t;
+};
+} // namespace PdmToPcm
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <numbers>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Fft
+{
+// An in place, iterative radix 2 FFT. Lengths must be powers of 2.
+using Complex = std::complex<double>;
+
+// The first half of the roots of unity for a transform of the given length.
+inline auto Twiddles(std::size_t const length) -> std::vector<Complex>
+{
+    std::vector<Complex> twiddles(length / 2);
+    for (std::size_t k = 0; k < twiddles.size(); ++k)
+    {
+        double const angle
+            = -2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(length);
+        twiddles[k] = std::polar(1.0, angle);
+    }
+    return twiddles;
+}
+
+inline void Forward(std::span<Complex> const data, std::span<Complex const> const twiddles)
+{
+    std::size_t const length = data.size();
+
+    for (std::size_t i = 1, j = 0; i < length; ++i)
+    {
+        std::size_t bit = length >> 1U;
+        for (; (j & bit) != 0; bit >>= 1U)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+
+        if (i < j)
+        {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (std::size_t span = 2; span <= length; span <<= 1U)
+    {
+        std::size_t const half = span / 2;
+        std::size_t const stride = length / span;
+        for (std::size_t i = 0; i < length; i += span)
+        {
+            for (std::size_t k = 0; k < half; ++k)
+            {
+                // Written out by hand, std::complex multiplication has to handle infinities and
+                // NaNs per IEEE 754 annex G which makes it several times slower. The locals are
+                // deliberately not const, GCC optimises const std::complex locals badly.
+                Complex twiddle = twiddles[k * stride];
+                double const real = data[i + k + half].real();
+                double const imag = data[i + k + half].imag();
+                Complex odd(
+                    real * twiddle.real() - imag * twiddle.imag(),
+                    real * twiddle.imag() + imag * twiddle.real());
+                Complex even = data[i + k];
+                data[i + k] = even + odd;
+                data[i + k + half] = even - odd;
+            }
+        }
+    }
+}
+
+// Unnormalised, the result is length times larger than the true inverse.
+inline void Inverse(std::span<Complex> const data, std::span<Complex const> const twiddles)
+{
+    for (auto& value : data)
+    {
+        value = std::conj(value);
+    }
+    Forward(data, twiddles);
+    for (auto& value : data)
+    {
+        value = std::conj(value);
+    }
+}
+} // namespace Fft
@@ -3,24 +3,36 @@
 #include "MathFunctions.hpp"
 #include <array>
 #include <cstddef>
+#include <numbers>
+#include <span>
 
 namespace Filters
 {
-template <std::size_t length>
-constexpr auto LowPass(
-    std::array<double, length> const window,
-    double const normalisedCutoffFrequency) -> std::array<double, length>
+// Fills filter, which must be as long as window, with the low pass kernel delayed by delay
+// samples. The delay may be fractional, only the sinc is shifted so the window stays centred.
+constexpr void LowPass(
+    std::span<double const> const window,
+    double const normalisedCutoffFrequency,
+    double const delay,
+    std::span<double> const filter)
 {
-    std::array<double, length> filter{};
-
-    auto const offset = (static_cast<double>(length) - 1.0) / 2.0;
+    auto const offset = (static_cast<double>(window.size()) - 1.0) / 2.0 + delay;
     auto const scale = 2.0 * normalisedCutoffFrequency;
-    for (std::size_t i = 0; i < length; ++i)
+    for (std::size_t i = 0; i < window.size(); ++i)
     {
         auto const t = static_cast<double>(i) - offset;
-        filter[i] = window[i] * scale * MathFunctions::Sinc(scale * t);
+        // MathFunctions::Sinc is the unnormalised sinc, the cutoff is in cycles per sample.
+        filter[i] = window[i] * scale * MathFunctions::Sinc(std::numbers::pi * scale * t);
     }
+}
 
+template <std::size_t length>
+constexpr auto LowPass(
+    std::array<double, length> const window,
+    double const normalisedCutoffFrequency) -> std::array<double, length>
+{
+    std::array<double, length> filter{};
+    LowPass(window, normalisedCutoffFrequency, 0.0, filter);
     return filter;
 }
-} // namespace Filters
\ No newline at end of file
+} // namespace Filters
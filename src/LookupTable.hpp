@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace LookupTable
+{
+// Each row of a lookup table holds the contribution of 8 consecutive kernel taps for every
+// possible byte of PDM input, the most significant bit being the earliest sample. A sample of 1
+// is taken as +0.5 and a sample of 0 as -0.5 so the output has no DC offset.
+constexpr std::size_t samplesPerRow = 8;
+constexpr std::size_t rowLength = 1U << samplesPerRow;
+using IntegerType = int16_t;
+using Row = std::array<IntegerType, rowLength>;
+
+// Every bank of a decimator built from the kernel finishes on a whole byte and they are staggered
+// by whole bytes, so the kernel length must be a multiple of decimationRate, which in turn must be
+// a multiple of samplesPerRow. Throws std::invalid_argument otherwise.
+inline void CheckGeometry(std::size_t const kernelLength, std::size_t const decimationRate)
+{
+    if (decimationRate == 0 || decimationRate % samplesPerRow != 0)
+    {
+        throw std::invalid_argument("The decimation rate must be a non-zero multiple of 8");
+    }
+    if (kernelLength == 0 || kernelLength % decimationRate != 0)
+    {
+        throw std::invalid_argument(
+            "The kernel length must be a non-zero multiple of the decimation rate");
+    }
+}
+
+// Gives a decimator one bank per output it has in flight, each pointed at the row it starts on with
+// a cleared accumulator. The banks are staggered so each finishes decimationRate samples after the
+// one before. A step of the table can hold several rows, e.g. one per channel.
+template <class Bank, class Rows>
+void StartBanks(
+    std::vector<Bank>& banks,
+    Rows const& rows,
+    std::size_t const decimationRate,
+    std::size_t const rowsPerStep = 1)
+{
+    std::size_t const numberOfSteps = rows.size() / rowsPerStep;
+    std::size_t const stepStagger = decimationRate / samplesPerRow;
+
+    banks.resize(numberOfSteps / stepStagger);
+    for (std::size_t i = 0; i < banks.size(); ++i)
+    {
+        auto const step = (numberOfSteps - (i * stepStagger)) % numberOfSteps;
+        banks[i].step_ = std::next(rows.cbegin(), static_cast<std::ptrdiff_t>(step * rowsPerStep));
+        banks[i].accumulator_ = 0;
+    }
+}
+
+// The largest scale that can be applied to the kernel without any row entry overflowing
+// IntegerType. Outputs of every engine built from the kernel are in these units.
+inline auto Scale(std::span<double const> const kernel) -> double
+{
+    constexpr double maxFilterInput = 0.5;
+
+    double maxRowSum = 0.0;
+    for (std::size_t row = 0; row < kernel.size() / samplesPerRow; ++row)
+    {
+        double rowSum = 0.0;
+        for (std::size_t shift = 0; shift < samplesPerRow; ++shift)
+        {
+            rowSum += maxFilterInput * std::abs(kernel[samplesPerRow * row + shift]);
+        }
+        maxRowSum = std::max(maxRowSum, rowSum);
+    }
+
+    return static_cast<double>(std::numeric_limits<IntegerType>::max()) / maxRowSum;
+}
+
+// Fills rows, which must be kernel.size() / samplesPerRow long.
+inline void Build(
+    std::span<double const> const kernel,
+    double const scale,
+    std::span<Row> const rows)
+{
+    for (std::size_t row = 0; row < rows.size(); ++row)
+    {
+        for (std::size_t pdm = 0; pdm < rowLength; ++pdm)
+        {
+            double rowSum = 0.0;
+            for (std::size_t shift = 0; shift < samplesPerRow; ++shift)
+            {
+                std::size_t const bitIdx = samplesPerRow - 1 - shift;
+                double const filterInput = static_cast<double>((pdm >> bitIdx) & 1U) - 0.5;
+                rowSum += filterInput * kernel[samplesPerRow * row + shift];
+            }
+
+            rows[row][pdm] = static_cast<IntegerType>(std::lround(std::clamp(
+                rowSum * scale,
+                static_cast<double>(std::numeric_limits<IntegerType>::min()),
+                static_cast<double>(std::numeric_limits<IntegerType>::max()))));
+        }
+    }
+}
+} // namespace LookupTable
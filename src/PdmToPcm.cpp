@@ -1,51 +1,466 @@
 #include "PdmToPcm.hpp"
+#include "Filters.hpp"
+#include "LookupTable.hpp"
+#include "PdmToPcmReconfigurable.hpp"
+#include "PdmToPcmShared.hpp"
+#include "Windows.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <iterator>
 #include <span>
 
 namespace PdmToPcm
 {
 Filter::Filter()
+    : Filter(DefaultLookupTable())
 {
-    constexpr size_t filterBankStepStagger = numberOfLookupTableSteps_ / numberOfFilterBanks_;
+}
+
+Filter::Filter(LookupTableLayout const layout)
+    : Filter(DefaultLookupTable())
+{
+    if (layout == LookupTableLayout::AccessOrder)
+    {
+        accessOrderLookupTable_ = &DefaultAccessOrderLookupTable();
+    }
+}
 
+Filter::Filter(SharedLookupTable const& lookupTable)
+    : Filter(lookupTable.Table())
+{
+}
+
+Filter::Filter(FilterTable const& lookupTable)
+    : Filter(lookupTable.Table())
+{
+}
+
+Filter::Filter(LookupTableType const& lookupTable)
+    : lookupTable_(&lookupTable)
+{
     for (size_t i = 0; i < numberOfFilterBanks_; ++i)
     {
+        auto const step = (numberOfLookupTableSteps_ - (i * filterBankStepStagger_))
+                        % numberOfLookupTableSteps_;
+        banks_.at(i).step_ = std::next(lookupTable_->begin(), static_cast<std::ptrdiff_t>(step));
+        banks_.at(i).accumulator_ = 0;
+    }
+}
+
+void Filter::Restart(LookupTableType const& lookupTable, Filter const& other)
+{
+    lookupTable_ = &lookupTable;
+    accessOrderLookupTable_ = nullptr;
+    idle_.Reset();
+    for (std::size_t i = 0; i < numberOfFilterBanks_; ++i)
+    {
+        // The other filter's banks may still be where its idle block began.
+        auto const step = static_cast<std::size_t>(
+            std::distance(other.lookupTable_->cbegin(), other.banks_.at(i).step_));
+        auto const position = (step + other.idle_.blockPosition_) % numberOfLookupTableSteps_;
         banks_.at(i).step_
-            = (numberOfLookupTableSteps_ - (i * filterBankStepStagger)) % numberOfLookupTableSteps_;
+            = std::next(lookupTable_->cbegin(), static_cast<std::ptrdiff_t>(position));
         banks_.at(i).accumulator_ = 0;
     }
 }
 
+auto Filter::DefaultLookupTable() -> LookupTableType const&
+{
+    static LookupTableType const lookupTable = []() {
+        LookupTableType table{};
+        BuildLookupTable(table);
+        return table;
+    }();
+
+    return lookupTable;
+}
+
+auto Filter::DefaultAccessOrderLookupTable() -> AccessOrderLookupTableType const&
+{
+    static AccessOrderLookupTableType const lookupTable = []() {
+        auto const& stepMajor = DefaultLookupTable();
+        AccessOrderLookupTableType table{};
+        for (std::size_t position = 0; position < filterBankStepStagger_; ++position)
+        {
+            for (std::size_t in = 0; in < lookupTableInnerDimension; ++in)
+            {
+                for (std::size_t group = 0; group < numberOfFilterBanks_; ++group)
+                {
+                    auto const step = group * filterBankStepStagger_ + position;
+                    table.at(position).at(in).at(group) = stepMajor.at(step).at(in);
+                }
+            }
+        }
+        return table;
+    }();
+
+    return lookupTable;
+}
+
+void Filter::BuildLookupTable(
+    LookupTableType& lookupTable,
+    double const normalisedCutoffFrequency)
+{
+    auto const kernel = Filters::LowPass(
+        Windows::Kaiser<filterLength_>(kaiserWindowBeta_),
+        normalisedCutoffFrequency);
+
+    LookupTable::Build(kernel, LookupTable::Scale(kernel), lookupTable);
+}
+
 auto Filter::Apply(std::span<uint8_t> const dataIn, std::span<int32_t> dataOut) -> std::size_t
 {
+    return Process(dataIn, dataOut).outputWritten_;
+}
+
+auto Filter::Process(std::span<uint8_t const> const dataIn, std::span<int32_t> const dataOut)
+    -> ApplyResult
+{
+    return ProcessImpl<false>(dataIn, dataOut, nullptr);
+}
+
+auto Filter::Process(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut,
+    Levels& levels) -> ApplyResult
+{
+    return ProcessImpl<true>(dataIn, dataOut, &levels);
+}
+
+template <bool metered>
+auto Filter::ProcessImpl(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut,
+    Levels* const levels) -> ApplyResult
+{
+    auto in = dataIn;
+    auto out = dataOut;
+    LevelAccumulator<metered> meter(levels);
+    std::size_t idleOutputs = 0;
+
+    while (!in.empty() && !out.empty())
+    {
+        if (idle_.repeating_)
+        {
+            auto const replayed = ReplayIdle(in, out);
+            for (auto const output : out.first(replayed.outputWritten_))
+            {
+                meter.Add(output);
+            }
+            idleOutputs += replayed.outputWritten_;
+            in = in.subspan(replayed.inputConsumed_);
+            out = out.subspan(replayed.outputWritten_);
+
+            if (in.empty() || out.empty())
+            {
+                break;
+            }
+            CatchUpIdle();
+        }
+
+        // Run the banks up to the point where the input becomes idle, or as far as the output has
+        // room for. If the output fills part way between outputs the banks stop short of that,
+        // and only the bytes they got through can be followed.
+        auto const room = std::min(in.size(), out.size() * bytesPerOutput_);
+        auto following = idle_;
+        auto const segment = in.first(following.Follow(in.first(room)));
+        auto const result = accessOrderLookupTable_ != nullptr
+                              ? ProcessAccessOrder<metered>(segment, out, levels)
+                              : ProcessStepMajor<metered>(segment, out, levels);
+        if (result.inputConsumed_ == segment.size())
+        {
+            idle_ = following;
+        }
+        else
+        {
+            idle_.Follow(segment.first(result.inputConsumed_));
+        }
+        idle_.Record(out.first(result.outputWritten_));
+        idle_.Capture(BytesToNextOutput());
+
+        in = in.subspan(result.inputConsumed_);
+        out = out.subspan(result.outputWritten_);
+    }
+
+    meter.Finish(levels, idleOutputs);
+
+    return {dataIn.size() - in.size(), dataOut.size() - out.size()};
+}
+
+template <bool metered>
+auto Filter::ProcessStepMajor(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut,
+    Levels* const levels) -> ApplyResult
+{
+    // The banks are staggered so that no two of them wrap on the same input byte, so every byte can
+    // be run through all of the banks before checking whether dataOut is full. This keeps the banks
+    // in step with each other and means input is only ever consumed in whole bytes.
+    static_assert(numberOfLookupTableSteps_ / numberOfFilterBanks_ > 0);
+
+    auto inIter = dataIn.begin();
     auto outIter = dataOut.begin();
+    LevelAccumulator<metered> meter(levels);
 
-    if (dataOut.size() > 0)
+    while (inIter != dataIn.end() && outIter != dataOut.end())
     {
-        for (auto const in : dataIn)
+        auto const in = *inIter;
+        ++inIter;
+
+        for (auto& bank : banks_)
         {
-            for (auto& bank : banks_)
+            bank.accumulator_ += bank.step_->at(in);
+            ++bank.step_;
+            if (bank.step_ == lookupTable_->end())
             {
-                bank.accumulator_ += bank.step_->at(in);
-                ++bank.step_;
-                if (bank.step_ == lookupTable_.end())
-                {
-                    (*outIter) = bank.accumulator_;
-                    ++outIter;
-                    bank.step_ = lookupTable_.begin();
-                    bank.accumulator_ = 0;
-
-                    if (outIter == dataOut.end())
-                    {
-                        return dataOut.size();
-                    }
-                }
+                (*outIter) = bank.accumulator_;
+                ++outIter;
+                meter.Add(bank.accumulator_);
+                bank.step_ = lookupTable_->begin();
+                bank.accumulator_ = 0;
             }
         }
     }
 
-    return std::distance(dataOut.begin(), outIter);
+    auto const outputWritten = static_cast<std::size_t>(std::distance(dataOut.begin(), outIter));
+    meter.Finish(levels, outputWritten);
+
+    return {static_cast<std::size_t>(std::distance(dataIn.begin(), inIter)), outputWritten};
+}
+
+template <bool metered>
+auto Filter::ProcessAccessOrder(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut,
+    Levels* const levels) -> ApplyResult
+{
+    // Every bank is at the same position within its group of filterBankStepStagger_ steps, so the
+    // banks are tracked for the call as that position and one accumulator per group.
+    auto const firstStep
+        = static_cast<std::size_t>(std::distance(lookupTable_->cbegin(), banks_[0].step_));
+    std::size_t position = firstStep % filterBankStepStagger_;
+
+    Accumulators sums{};
+    for (auto const& bank : banks_)
+    {
+        auto const step
+            = static_cast<std::size_t>(std::distance(lookupTable_->cbegin(), bank.step_));
+        sums.at(step / filterBankStepStagger_) = bank.accumulator_;
+    }
+
+    auto inIter = dataIn.begin();
+    auto outIter = dataOut.begin();
+    LevelAccumulator<metered> meter(levels);
+
+    while (inIter != dataIn.end() && outIter != dataOut.end())
+    {
+        auto const& entries = (*accessOrderLookupTable_)[position][*inIter];
+        ++inIter;
+
+        for (std::size_t group = 0; group < numberOfFilterBanks_; ++group)
+        {
+            sums[group] += entries[group];
+        }
+
+        ++position;
+        if (position == filterBankStepStagger_)
+        {
+            // The bank in the last group has finished, every other bank moves up a group and the
+            // finished one starts again in the first.
+            position = 0;
+            (*outIter) = sums.back();
+            ++outIter;
+            meter.Add(sums.back());
+            std::copy_backward(sums.begin(), std::prev(sums.end()), sums.end());
+            sums.front() = 0;
+        }
+    }
+
+    for (std::size_t group = 0; group < numberOfFilterBanks_; ++group)
+    {
+        auto const step = group * filterBankStepStagger_ + position;
+        banks_.at(group).step_
+            = std::next(lookupTable_->cbegin(), static_cast<std::ptrdiff_t>(step));
+        banks_.at(group).accumulator_ = sums.at(group);
+    }
+
+    auto const outputWritten = static_cast<std::size_t>(std::distance(dataOut.begin(), outIter));
+    meter.Finish(levels, outputWritten);
+
+    return {static_cast<std::size_t>(std::distance(dataIn.begin(), inIter)), outputWritten};
+}
+
+auto Filter::ReplayIdle(std::span<uint8_t const> const dataIn, std::span<int32_t> const dataOut)
+    -> ApplyResult
+{
+    std::size_t inputConsumed = 0;
+    std::size_t outputWritten = 0;
+    while (inputConsumed < dataIn.size() && outputWritten < dataOut.size())
+    {
+        auto const in = dataIn.subspan(inputConsumed);
+        auto const out = dataOut.subspan(outputWritten);
+        if (idle_.blockPosition_ == 0 && in.size() >= idleBlockLength_
+            && out.size() >= idleBlockOutputs_
+            && std::equal(idle_.block_.begin(), idle_.block_.end(), in.begin()))
+        {
+            std::copy(idle_.blockOutputs_.begin(), idle_.blockOutputs_.end(), out.begin());
+            idle_.run_ += idleBlockLength_;
+            inputConsumed += idleBlockLength_;
+            outputWritten += idleBlockOutputs_;
+            continue;
+        }
+
+        // Less than a block of input or output left, go a byte at a time.
+        auto const position = idle_.blockPosition_;
+        if (in.front() != idle_.block_[position])
+        {
+            break;
+        }
+        if (position % bytesPerOutput_ == idle_.outputOffset_)
+        {
+            out.front() = idle_.blockOutputs_[position / bytesPerOutput_];
+            ++outputWritten;
+        }
+        ++idle_.run_;
+        ++inputConsumed;
+        idle_.blockPosition_ = (position + 1) % idleBlockLength_;
+    }
+
+    return {inputConsumed, outputWritten};
+}
+
+void Filter::CatchUpIdle()
+{
+    auto const behind = std::span<uint8_t const>(idle_.block_).first(idle_.blockPosition_);
+    idle_.Stop();
+
+    // The outputs were already produced by ReplayIdle(). One more than a block's worth of room
+    // lets the banks get through every byte.
+    std::array<int32_t, idleBlockOutputs_ + 1> unused{};
+    if (accessOrderLookupTable_ != nullptr)
+    {
+        ProcessAccessOrder<false>(behind, unused, nullptr);
+    }
+    else
+    {
+        ProcessStepMajor<false>(behind, unused, nullptr);
+    }
+}
+
+auto Filter::BytesToNextOutput() const -> std::size_t
+{
+    auto const step
+        = static_cast<std::size_t>(std::distance(lookupTable_->cbegin(), banks_[0].step_));
+    return bytesPerOutput_ - (step % filterBankStepStagger_);
+}
+
+auto Filter::IdleState::Follow(std::span<uint8_t const> const input, bool const untilIdle)
+    -> std::size_t
+{
+    // Every bank's window, from one block back, has to be made of nothing but the repeat.
+    constexpr std::size_t idleRun = numberOfLookupTableSteps_ + idleBlockLength_ - idlePeriod_;
+
+    std::size_t followed = 0;
+    auto const follow = [&](bool const repeated) {
+        run_ = repeated ? run_ + 1 : 0;
+        ++followed;
+        return !untilIdle || run_ < idleRun;
+    };
+
+    // The first few bytes are compared with the ones from before, the rest with the input.
+    bool following = true;
+    for (std::size_t i = 0; following && i < std::min(input.size(), idlePeriod_); ++i)
+    {
+        bool const seen = i + recentBytesSeen_ >= idlePeriod_;
+        following = follow(seen && input[i] == recentBytes_[i]);
+    }
+    for (std::size_t i = idlePeriod_; following && i < input.size(); ++i)
+    {
+        following = follow(input[i] == input[i - idlePeriod_]);
+    }
+
+    auto const count = static_cast<std::ptrdiff_t>(std::min(followed, idlePeriod_));
+    auto const end = input.begin() + static_cast<std::ptrdiff_t>(followed);
+    std::shift_left(recentBytes_.begin(), recentBytes_.end(), count);
+    std::copy(end - count, end, recentBytes_.end() - count);
+    recentBytesSeen_ = std::min(recentBytesSeen_ + followed, idlePeriod_);
+
+    return followed;
+}
+
+void Filter::IdleState::Record(std::span<int32_t const> const outputs)
+{
+    auto const count = static_cast<std::ptrdiff_t>(std::min(outputs.size(), recentOutputs_.size()));
+    std::shift_left(recentOutputs_.begin(), recentOutputs_.end(), count);
+    std::copy(outputs.end() - count, outputs.end(), recentOutputs_.end() - count);
+}
+
+void Filter::IdleState::Capture(std::size_t const bytesToNextOutput)
+{
+    repeating_ = run_ + idlePeriod_ >= numberOfLookupTableSteps_ + idleBlockLength_;
+    blockPosition_ = 0;
+    if (!repeating_)
+    {
+        return;
+    }
+
+    // The next block is the same as the last one, which repeats the last idlePeriod_ bytes. The
+    // last block held exactly idleBlockOutputs_ outputs at the same positions.
+    for (std::size_t i = 0; i < idleBlockLength_; ++i)
+    {
+        block_[i] = recentBytes_[i % idlePeriod_];
+    }
+    blockOutputs_ = recentOutputs_;
+    outputOffset_ = bytesToNextOutput - 1;
+}
+
+void Filter::IdleState::Stop()
+{
+    for (std::size_t i = 0; i < idlePeriod_; ++i)
+    {
+        recentBytes_[i] = block_[(blockPosition_ + i) % idleBlockLength_];
+    }
+
+    auto const outputsInBlock
+        = blockPosition_ > outputOffset_
+            ? (blockPosition_ - outputOffset_ - 1) / bytesPerOutput_ + 1
+            : 0;
+    for (std::size_t i = 0; i < idleBlockOutputs_; ++i)
+    {
+        recentOutputs_[i] = blockOutputs_[(outputsInBlock + i) % idleBlockOutputs_];
+    }
+
+    repeating_ = false;
+    blockPosition_ = 0;
+}
+
+void Filter::IdleState::Reset()
+{
+    *this = IdleState{};
+}
+
+void Filter::Levels::Reset()
+{
+    peak_ = 0;
+    sumOfSquares_ = 0;
+    clipCount_ = 0;
+    sampleCount_ = 0;
+}
+
+auto Filter::Levels::Rms() const -> double
+{
+    if (sampleCount_ == 0)
+    {
+        return 0.0;
+    }
+    return std::sqrt(static_cast<double>(sumOfSquares_) / static_cast<double>(sampleCount_));
+}
+
+auto Filter::Levels::Active(double const rmsThreshold) const -> bool
+{
+    return Rms() >= rmsThreshold;
 }
-} // namespace PdmToPcm
\ No newline at end of file
+} // namespace PdmToPcm
@@ -0,0 +1,136 @@
+#include "PdmToPcmBeamformer.hpp"
+#include "Filters.hpp"
+#include "LookupTable.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace PdmToPcm
+{
+namespace
+{
+constexpr uint8_t idleByte = 0x55;
+} // namespace
+
+BeamformingFilter::BeamformingFilter(
+    std::span<double const> const window,
+    double const normalisedCutoffFrequency,
+    std::size_t const decimationRate,
+    std::span<double const> const delays)
+    : numberOfChannels_(delays.size())
+    , delayLines_(delays.size())
+    , delayed_(delays.size())
+{
+    if (delays.empty())
+    {
+        throw std::invalid_argument("A beamformer needs at least one channel");
+    }
+    LookupTable::CheckGeometry(window.size(), decimationRate);
+
+    auto const smallestDelay = *std::min_element(delays.begin(), delays.end());
+    std::size_t const numberOfSteps = window.size() / LookupTable::samplesPerRow;
+
+    std::vector<std::vector<double>> kernels(numberOfChannels_);
+    double scale = 0.0;
+    for (std::size_t channel = 0; channel < numberOfChannels_; ++channel)
+    {
+        auto const delay = delays[channel] - smallestDelay;
+        auto const delayBytes = static_cast<std::size_t>(
+            std::floor(delay / static_cast<double>(LookupTable::samplesPerRow)));
+        auto const remainder
+            = delay - static_cast<double>(delayBytes * LookupTable::samplesPerRow);
+
+        delayLines_[channel].bytes_.assign(delayBytes, idleByte);
+
+        // The kernel weights the earliest sample of its window first, so looking further back in
+        // the input means moving the prototype the other way.
+        kernels[channel].resize(window.size());
+        Filters::LowPass(window, normalisedCutoffFrequency, -remainder, kernels[channel]);
+
+        // One scale for every channel keeps their outputs in the same units.
+        auto const channelScale = LookupTable::Scale(kernels[channel]);
+        scale = channel == 0 ? channelScale : std::min(scale, channelScale);
+    }
+
+    lookupTable_.resize(numberOfSteps * numberOfChannels_);
+    std::vector<LookupTable::Row> rows(numberOfSteps);
+    for (std::size_t channel = 0; channel < numberOfChannels_; ++channel)
+    {
+        LookupTable::Build(kernels[channel], scale, rows);
+        for (std::size_t step = 0; step < numberOfSteps; ++step)
+        {
+            lookupTable_[step * numberOfChannels_ + channel] = rows[step];
+        }
+    }
+
+    LookupTable::StartBanks(banks_, lookupTable_, decimationRate, numberOfChannels_);
+}
+
+auto BeamformingFilter::DelayLine::Push(uint8_t const in) -> uint8_t
+{
+    if (bytes_.empty())
+    {
+        return in;
+    }
+
+    auto const out = bytes_[next_];
+    bytes_[next_] = in;
+    next_ = (next_ + 1) % bytes_.size();
+    return out;
+}
+
+auto BeamformingFilter::Process(
+    std::span<std::span<uint8_t const> const> const dataIn,
+    std::span<int32_t> const dataOut) -> Filter::ApplyResult
+{
+    if (dataIn.size() != numberOfChannels_)
+    {
+        throw std::invalid_argument("Expected one input per channel");
+    }
+
+    std::size_t const inputLength = dataIn.front().size();
+    if (std::any_of(dataIn.begin(), dataIn.end(), [&](auto const& channel) {
+            return channel.size() != inputLength;
+        }))
+    {
+        throw std::invalid_argument("Every channel's input must be the same length");
+    }
+
+    auto const channels = static_cast<std::ptrdiff_t>(numberOfChannels_);
+    std::size_t in = 0;
+    auto outIter = dataOut.begin();
+
+    while (in != inputLength && outIter != dataOut.end())
+    {
+        for (std::size_t channel = 0; channel < numberOfChannels_; ++channel)
+        {
+            delayed_[channel] = delayLines_[channel].Push(dataIn[channel][in]);
+        }
+        ++in;
+
+        for (auto& bank : banks_)
+        {
+            for (std::size_t channel = 0; channel < numberOfChannels_; ++channel)
+            {
+                bank.accumulator_ += bank.step_[static_cast<std::ptrdiff_t>(channel)]
+                                         [delayed_[channel]];
+            }
+            bank.step_ += channels;
+            if (bank.step_ == lookupTable_.cend())
+            {
+                (*outIter) = bank.accumulator_;
+                ++outIter;
+                bank.step_ = lookupTable_.cbegin();
+                bank.accumulator_ = 0;
+            }
+        }
+    }
+
+    return {in, static_cast<std::size_t>(std::distance(dataOut.begin(), outIter))};
+}
+} // namespace PdmToPcm
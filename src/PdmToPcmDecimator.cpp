@@ -0,0 +1,237 @@
+#include "PdmToPcmDecimator.hpp"
+#include "Fft.hpp"
+#include "LookupTable.hpp"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numbers>
+#include <span>
+#include <variant>
+
+namespace PdmToPcm
+{
+LookupTableFilter::LookupTableFilter(
+    std::span<double const> const kernel,
+    std::size_t const decimationRate)
+    : LookupTableFilter(kernel, decimationRate, LookupTable::Scale(kernel))
+{
+}
+
+LookupTableFilter::LookupTableFilter(
+    std::span<double const> const kernel,
+    std::size_t const decimationRate,
+    double const scale)
+    : lookupTable_(kernel.size() / LookupTable::samplesPerRow)
+{
+    LookupTable::CheckGeometry(kernel.size(), decimationRate);
+    LookupTable::Build(kernel, scale, lookupTable_);
+
+    LookupTable::StartBanks(banks_, lookupTable_, decimationRate);
+}
+
+auto LookupTableFilter::Process(std::span<uint8_t const> const dataIn, std::span<int32_t> dataOut)
+    -> Filter::ApplyResult
+{
+    auto inIter = dataIn.begin();
+    auto outIter = dataOut.begin();
+
+    while (inIter != dataIn.end() && outIter != dataOut.end())
+    {
+        auto const in = *inIter;
+        ++inIter;
+
+        for (auto& bank : banks_)
+        {
+            bank.accumulator_ += bank.step_->at(in);
+            ++bank.step_;
+            if (bank.step_ == lookupTable_.cend())
+            {
+                (*outIter) = bank.accumulator_;
+                ++outIter;
+                bank.step_ = lookupTable_.cbegin();
+                bank.accumulator_ = 0;
+            }
+        }
+    }
+
+    return {
+        static_cast<std::size_t>(std::distance(dataIn.begin(), inIter)),
+        static_cast<std::size_t>(std::distance(dataOut.begin(), outIter))};
+}
+
+FftFilter::FftFilter(std::span<double const> const kernel, std::size_t const decimationRate)
+    : decimationRate_(decimationRate)
+    , historyLength_(kernel.size() - 1)
+    // Only every decimationRate_ output is needed. Folding the spectrum by the power of 2 part of
+    // the decimation rate gives those outputs (and a few more) from a much shorter inverse.
+    , fold_(decimationRate & (~decimationRate + 1))
+{
+    LookupTable::CheckGeometry(kernel.size(), decimationRate);
+
+    // The longer the transform the more of it is new input rather than history, at 4 times the
+    // kernel length about three quarters is. Each block has to hold a whole number of outputs
+    // (and so of input bytes) to keep the decimation phase fixed.
+    std::size_t transformLength = 1;
+    while (transformLength < 4 * kernel.size())
+    {
+        transformLength <<= 1U;
+    }
+    blockLength_ = ((transformLength - historyLength_) / decimationRate_) * decimationRate_;
+
+    twiddles_ = Fft::Twiddles(transformLength);
+    foldedTwiddles_ = Fft::Twiddles(transformLength / fold_);
+    spectrum_.resize(transformLength);
+    folded_.resize(transformLength / fold_);
+    samples_.resize(historyLength_ + 2 * blockLength_);
+    pending_.resize(2 * blockLength_ / decimationRate_);
+    pendingIndex_ = pending_.size();
+
+    // Each output is the kernel applied to the window of samples ending at it, i.e. a convolution
+    // with the reversed kernel. The first output of a block is at sample historyLength_ +
+    // decimationRate_ - 1, shifting by that lines it up with the start of the folded inverse.
+    // The output scale and the normalisation of the inverse are folded in too.
+    kernelSpectrum_.resize(transformLength);
+    std::reverse_copy(kernel.begin(), kernel.end(), kernelSpectrum_.begin());
+    Fft::Forward(kernelSpectrum_, twiddles_);
+
+    auto const firstOutput = static_cast<double>(historyLength_ + decimationRate_ - 1);
+    double const scale = LookupTable::Scale(kernel) / static_cast<double>(transformLength);
+    for (std::size_t i = 0; i < transformLength; ++i)
+    {
+        double const angle = 2.0 * std::numbers::pi * static_cast<double>(i) * firstOutput
+                           / static_cast<double>(transformLength);
+        kernelSpectrum_[i] *= std::polar(scale, angle);
+    }
+}
+
+void FftFilter::ApplyBlocks()
+{
+    // The kernel is real so two blocks can share one transform, the first in the real part and
+    // the second in the imaginary part. Each block is a window of historyLength_ + blockLength_
+    // samples padded out with zeros.
+    std::size_t const windowLength = historyLength_ + blockLength_;
+    for (std::size_t i = 0; i < spectrum_.size(); ++i)
+    {
+        spectrum_[i] = i < windowLength
+                         ? std::complex<double>(samples_[i], samples_[blockLength_ + i])
+                         : std::complex<double>();
+    }
+
+    Fft::Forward(spectrum_, twiddles_);
+
+    std::fill(folded_.begin(), folded_.end(), std::complex<double>());
+    for (std::size_t i = 0; i < spectrum_.size(); i += folded_.size())
+    {
+        for (std::size_t j = 0; j < folded_.size(); ++j)
+        {
+            std::complex<double> kernel = kernelSpectrum_[i + j];
+            double const real = spectrum_[i + j].real();
+            double const imag = spectrum_[i + j].imag();
+            folded_[j] += std::complex<double>(
+                real * kernel.real() - imag * kernel.imag(),
+                real * kernel.imag() + imag * kernel.real());
+        }
+    }
+
+    Fft::Inverse(folded_, foldedTwiddles_);
+
+    // The folded inverse holds every fold_ output starting from the first, and every
+    // decimationRate_ of those is wanted.
+    std::size_t const outputsPerBlock = blockLength_ / decimationRate_;
+    std::size_t const stride = decimationRate_ / fold_;
+    for (std::size_t i = 0; i < outputsPerBlock; ++i)
+    {
+        auto const output = folded_[i * stride];
+        pending_[i] = static_cast<int32_t>(std::lround(output.real()));
+        pending_[outputsPerBlock + i] = static_cast<int32_t>(std::lround(output.imag()));
+    }
+    pendingIndex_ = 0;
+
+    std::copy_n(
+        std::next(samples_.begin(), static_cast<std::ptrdiff_t>(2 * blockLength_)),
+        historyLength_,
+        samples_.begin());
+    blockFill_ = 0;
+}
+
+auto FftFilter::Process(std::span<uint8_t const> const dataIn, std::span<int32_t> dataOut)
+    -> Filter::ApplyResult
+{
+    auto inIter = dataIn.begin();
+    auto outIter = dataOut.begin();
+
+    while (true)
+    {
+        while (pendingIndex_ < pending_.size() && outIter != dataOut.end())
+        {
+            (*outIter) = pending_[pendingIndex_];
+            ++outIter;
+            ++pendingIndex_;
+        }
+
+        if (outIter == dataOut.end() || inIter == dataIn.end())
+        {
+            break;
+        }
+
+        auto sampleIter = std::next(
+            samples_.begin(),
+            static_cast<std::ptrdiff_t>(historyLength_ + blockFill_));
+        while (blockFill_ < 2 * blockLength_ && inIter != dataIn.end())
+        {
+            auto const in = *inIter;
+            ++inIter;
+
+            for (std::size_t bitIdx = 8; bitIdx-- > 0;)
+            {
+                (*sampleIter) = static_cast<double>((in >> bitIdx) & 1U) - 0.5;
+                ++sampleIter;
+            }
+            blockFill_ += 8;
+        }
+
+        if (blockFill_ == 2 * blockLength_)
+        {
+            ApplyBlocks();
+        }
+    }
+
+    return {
+        static_cast<std::size_t>(std::distance(dataIn.begin(), inIter)),
+        static_cast<std::size_t>(std::distance(dataOut.begin(), outIter))};
+}
+
+auto Decimator::CreateEngine(
+    std::span<double const> const kernel,
+    std::size_t const decimationRate,
+    std::size_t const fftTapThreshold) -> Engine
+{
+    if (kernel.size() > fftTapThreshold)
+    {
+        return Engine(std::in_place_type<FftFilter>, kernel, decimationRate);
+    }
+    return Engine(std::in_place_type<LookupTableFilter>, kernel, decimationRate);
+}
+
+Decimator::Decimator(
+    std::span<double const> const kernel,
+    std::size_t const decimationRate,
+    std::size_t const fftTapThreshold)
+    : engine_(CreateEngine(kernel, decimationRate, fftTapThreshold))
+{
+}
+
+auto Decimator::Process(std::span<uint8_t const> const dataIn, std::span<int32_t> const dataOut)
+    -> Filter::ApplyResult
+{
+    return std::visit([&](auto& engine) { return engine.Process(dataIn, dataOut); }, engine_);
+}
+
+auto Decimator::UsesFft() const -> bool
+{
+    return std::holds_alternative<FftFilter>(engine_);
+}
+} // namespace PdmToPcm
@@ -0,0 +1,88 @@
+#include "PdmToPcmMultiRate.hpp"
+#include "Filters.hpp"
+#include "Windows.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+
+namespace PdmToPcm
+{
+auto MultiRateFilter::SecondStageKernel() -> SecondStageKernelType const&
+{
+    static SecondStageKernelType const kernel = []() {
+        // Leave a little room below the decimated Nyquist frequency for the transition band.
+        constexpr double cutoff = 0.9 * 0.5 / static_cast<double>(secondStageDecimationRate_);
+        constexpr double kaiserWindowBeta = 5.4;
+
+        auto const filter = Filters::LowPass(
+            Windows::Kaiser<secondStageLength_>(kaiserWindowBeta),
+            cutoff);
+
+        // Normalise to unity gain at DC so both outputs are on the same scale.
+        double sum = 0.0;
+        for (auto const coefficient : filter)
+        {
+            sum += coefficient;
+        }
+
+        constexpr auto one = static_cast<double>(1 << secondStageFractionalBits_);
+        SecondStageKernelType quantised{};
+        for (std::size_t i = 0; i < secondStageLength_; ++i)
+        {
+            quantised.at(i) = static_cast<int32_t>(std::lround(one * filter.at(i) / sum));
+        }
+        return quantised;
+    }();
+
+    return kernel;
+}
+
+auto MultiRateFilter::Process(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut,
+    std::span<int32_t> const dataOutDecimated) -> ApplyResult
+{
+    // Only let the first stage produce as many samples as the second stage has room for. Every
+    // secondStageDecimationRate_ samples produce one decimated output.
+    std::size_t const decimatedCapacity
+        = dataOutDecimated.size() * secondStageDecimationRate_
+        + (secondStageDecimationRate_ - 1 - samplesSinceOutput_);
+    auto const result
+        = firstStage_.Process(dataIn, dataOut.first(std::min(dataOut.size(), decimatedCapacity)));
+
+    auto const& kernel = SecondStageKernel();
+    auto outIter = dataOutDecimated.begin();
+
+    for (auto const sample : dataOut.first(result.outputWritten_))
+    {
+        history_.at(historyIndex_) = sample;
+        history_.at(historyIndex_ + secondStageLength_) = sample;
+        historyIndex_ = (historyIndex_ + 1) % secondStageLength_;
+
+        ++samplesSinceOutput_;
+        if (samplesSinceOutput_ == secondStageDecimationRate_)
+        {
+            samplesSinceOutput_ = 0;
+
+            // The kernel is symmetric so it doesn't need reversing against the history.
+            int64_t sum = 0;
+            for (std::size_t i = 0; i < secondStageLength_; ++i)
+            {
+                sum += static_cast<int64_t>(kernel[i]) * history_[historyIndex_ + i];
+            }
+
+            (*outIter) = static_cast<int32_t>(sum >> secondStageFractionalBits_);
+            ++outIter;
+        }
+    }
+
+    return {
+        result.inputConsumed_,
+        result.outputWritten_,
+        static_cast<std::size_t>(std::distance(dataOutDecimated.begin(), outIter))};
+}
+} // namespace PdmToPcm
@@ -0,0 +1,138 @@
+#include "PdmToPcmReconfigurable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace PdmToPcm
+{
+FilterTable::FilterTable(double const normalisedCutoffFrequency)
+{
+    Filter::BuildLookupTable(table_, normalisedCutoffFrequency);
+}
+
+auto FilterTable::Table() const -> Filter::LookupTableType const&
+{
+    return table_;
+}
+
+ReconfigurableFilter::ReconfigurableFilter(std::size_t const crossfadeLength)
+    : crossfadeLength_(std::max<std::size_t>(crossfadeLength, 1))
+{
+}
+
+auto ReconfigurableFilter::Active() -> Filter&
+{
+    return filters_.at(active_);
+}
+
+auto ReconfigurableFilter::Incoming() -> Filter&
+{
+    return filters_.at(1 - active_);
+}
+
+void ReconfigurableFilter::Publish(Filter::LookupTableType const& lookupTable)
+{
+    requested_.store(&lookupTable, std::memory_order_release);
+}
+
+void ReconfigurableFilter::Reconfigure(FilterTable const& lookupTable)
+{
+    Publish(lookupTable.Table());
+}
+
+void ReconfigurableFilter::ReconfigureDefault()
+{
+    Publish(Filter::DefaultLookupTable());
+}
+
+auto ReconfigurableFilter::Switching() const -> bool
+{
+    return state_ == State::Switching;
+}
+
+auto ReconfigurableFilter::Process(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut) -> Filter::ApplyResult
+{
+    if (state_ == State::Steady)
+    {
+        auto const* const lookupTable = requested_.exchange(nullptr, std::memory_order_acquire);
+        if (lookupTable == nullptr)
+        {
+            return Active().Process(dataIn, dataOut);
+        }
+
+        Incoming().Restart(*lookupTable, Active());
+        state_ = State::Switching;
+        switchProgress_ = 0;
+    }
+
+    auto const switched = Switch(dataIn, dataOut);
+    if (state_ == State::Switching)
+    {
+        return switched;
+    }
+
+    auto const rest = Active().Process(
+        dataIn.subspan(switched.inputConsumed_),
+        dataOut.subspan(switched.outputWritten_));
+    return {
+        switched.inputConsumed_ + rest.inputConsumed_,
+        switched.outputWritten_ + rest.outputWritten_};
+}
+
+auto ReconfigurableFilter::Switch(
+    std::span<uint8_t const> const dataIn,
+    std::span<int32_t> const dataOut) -> Filter::ApplyResult
+{
+    // Until every bank of the incoming filter has been round once its outputs are missing the
+    // start of their kernel.
+    constexpr std::size_t warmUpLength = Filter::numberOfFilterBanks_;
+    auto const crossfadeLength = static_cast<int64_t>(crossfadeLength_);
+
+    std::size_t inputConsumed = 0;
+    std::size_t outputWritten = 0;
+    while (state_ == State::Switching && inputConsumed < dataIn.size()
+           && outputWritten < dataOut.size())
+    {
+        auto const in = dataIn.subspan(inputConsumed);
+        auto const out = dataOut.subspan(outputWritten)
+                             .first(std::min(dataOut.size() - outputWritten, incomingOut_.size()));
+
+        // Both filters have their banks at the same steps so they produce the same number of
+        // outputs from the same input. The incoming filter is given as much room as the active
+        // one so that it always consumes all of it, even when it produces nothing.
+        auto const result = Active().Process(in, out);
+        Incoming().Process(
+            in.first(result.inputConsumed_),
+            std::span(incomingOut_).first(out.size()));
+
+        for (std::size_t i = 0; i < result.outputWritten_; ++i)
+        {
+            if (switchProgress_ >= warmUpLength)
+            {
+                auto const step = std::min(
+                    static_cast<int64_t>(switchProgress_ - warmUpLength) + 1,
+                    crossfadeLength);
+                auto const from = static_cast<int64_t>(out[i]);
+                auto const to = static_cast<int64_t>(incomingOut_.at(i));
+                out[i] = static_cast<int32_t>(from + (to - from) * step / crossfadeLength);
+            }
+            ++switchProgress_;
+        }
+
+        inputConsumed += result.inputConsumed_;
+        outputWritten += result.outputWritten_;
+
+        if (switchProgress_ >= warmUpLength + crossfadeLength_)
+        {
+            active_ = 1 - active_;
+            state_ = State::Steady;
+        }
+    }
+
+    return {inputConsumed, outputWritten};
+}
+} // namespace PdmToPcm
@@ -0,0 +1,347 @@
+#include "PdmToPcmShared.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace PdmToPcm
+{
+namespace
+{
+constexpr uint32_t headerMagic = 0x4c4d4450; // "PDML"
+constexpr uint32_t headerVersion = 1;
+
+constexpr std::size_t hugePageSize = 2U * 1024U * 1024U;
+constexpr char const* hugePageDirectory = "/dev/hugepages";
+
+// The table starts on its own page after the header.
+constexpr std::size_t tableOffset = 4096;
+
+constexpr auto readyTimeout = std::chrono::seconds(5);
+constexpr auto readyPollInterval = std::chrono::milliseconds(1);
+
+struct Header
+{
+    uint32_t magic_;
+    uint32_t version_;
+    uint32_t ready_;
+    uint32_t decimationRate_;
+    uint32_t filterLength_;
+    uint32_t samplesPerLookupTableStep_;
+    double kaiserWindowBeta_;
+    uint64_t lookupTableSize_;
+};
+
+static_assert(sizeof(Header) <= tableOffset);
+
+class FileDescriptor
+{
+    int fd_;
+
+public:
+    explicit FileDescriptor(int const fd)
+        : fd_(fd)
+    {
+    }
+
+    ~FileDescriptor()
+    {
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+        }
+    }
+
+    FileDescriptor(FileDescriptor const&) = delete;
+    FileDescriptor(FileDescriptor&&) = delete;
+    void operator=(FileDescriptor const&) = delete;
+    void operator=(FileDescriptor&&) = delete;
+
+    [[nodiscard]] auto Get() const -> int
+    {
+        return fd_;
+    }
+};
+
+auto OpenSegment(std::string const& path, int const flags, bool const hugePages) -> int
+{
+    constexpr mode_t mode = 0644;
+    return hugePages ? ::open(path.c_str(), flags | O_CLOEXEC, mode)
+                     : ::shm_open(path.c_str(), flags, mode);
+}
+
+void RemoveSegment(std::string const& path, bool const hugePages)
+{
+    if (hugePages)
+    {
+        ::unlink(path.c_str());
+    }
+    else
+    {
+        ::shm_unlink(path.c_str());
+    }
+}
+
+auto Ready(Header const& header) -> bool
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast): only ever loaded from.
+    std::atomic_ref<uint32_t> const ready(const_cast<uint32_t&>(header.ready_));
+    return ready.load(std::memory_order_acquire) != 0;
+}
+
+struct Mapping
+{
+    void* address_;
+    std::size_t size_;
+};
+
+// Sizes and maps a segment this process just created and builds the table in it. Returns
+// std::nullopt if the segment can't be backed, e.g. hugetlbfs has no free pages.
+template <class BuildTable>
+auto Create(
+    int const fd,
+    std::size_t const size,
+    Header const& expected,
+    BuildTable const& buildTable) -> std::optional<Mapping>
+{
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        return std::nullopt;
+    }
+
+    void* const address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        return std::nullopt;
+    }
+
+    auto* const bytes = static_cast<std::byte*>(address);
+    auto* const header = new (bytes) Header(expected);
+    buildTable(bytes + tableOffset);
+
+    std::atomic_ref<uint32_t>(header->ready_).store(1, std::memory_order_release);
+    ::mprotect(address, size, PROT_READ);
+
+    return Mapping{address, size};
+}
+
+// Maps a segment another process created, waiting for it to finish building the table, and checks
+// that the table was built for the same filter. Returns std::nullopt if the segment is removed
+// before it is finished, is never finished or can't be mapped, so the caller can fall back.
+auto Attach(int const fd, std::string const& path, Header const& expected)
+    -> std::optional<Mapping>
+{
+    auto const deadline = std::chrono::steady_clock::now() + readyTimeout;
+
+    // The creator may not have sized the segment yet, or may give up on it and remove it.
+    struct stat status{};
+    while (true)
+    {
+        if (::fstat(fd, &status) != 0 || status.st_nlink == 0)
+        {
+            return std::nullopt;
+        }
+        if (status.st_size > 0)
+        {
+            break;
+        }
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return std::nullopt;
+        }
+        std::this_thread::sleep_for(readyPollInterval);
+    }
+
+    auto const size = static_cast<std::size_t>(status.st_size);
+    if (size < tableOffset + expected.lookupTableSize_)
+    {
+        throw std::runtime_error(path + " is too small to hold the lookup table");
+    }
+
+    void* const address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        return std::nullopt;
+    }
+
+    auto const& header = *static_cast<Header const*>(address);
+    while (!Ready(header))
+    {
+        if (::fstat(fd, &status) != 0 || status.st_nlink == 0
+            || std::chrono::steady_clock::now() > deadline)
+        {
+            ::munmap(address, size);
+            return std::nullopt;
+        }
+        std::this_thread::sleep_for(readyPollInterval);
+    }
+
+    if (header.magic_ != expected.magic_ || header.version_ != expected.version_
+        || header.decimationRate_ != expected.decimationRate_
+        || header.filterLength_ != expected.filterLength_
+        || header.samplesPerLookupTableStep_ != expected.samplesPerLookupTableStep_
+        || header.kaiserWindowBeta_ != expected.kaiserWindowBeta_
+        || header.lookupTableSize_ != expected.lookupTableSize_)
+    {
+        ::munmap(address, size);
+        throw std::runtime_error(path + " holds a lookup table for a different filter");
+    }
+
+    return Mapping{address, size};
+}
+
+auto SegmentExists(std::string const& path, bool const hugePages) -> bool
+{
+    FileDescriptor const fd(OpenSegment(path, O_RDONLY, hugePages));
+    return fd.Get() >= 0;
+}
+
+// Creates the ordinary POSIX shared memory segment, or maps it if another process already has.
+template <class BuildTable>
+auto OpenOrdinary(std::string const& name, Header const& expected, BuildTable const& buildTable)
+    -> Mapping
+{
+    std::size_t const size = tableOffset + expected.lookupTableSize_;
+
+    int const created = OpenSegment(name, O_RDWR | O_CREAT | O_EXCL, false);
+    if (created >= 0)
+    {
+        FileDescriptor const fd(created);
+        auto const mapping = Create(fd.Get(), size, expected, buildTable);
+        if (!mapping)
+        {
+            auto const error = errno;
+            // Let whoever comes next try again rather than wait on a table that will never be
+            // built.
+            RemoveSegment(name, false);
+            throw std::system_error(error, std::generic_category(), "Failed to create " + name);
+        }
+        return *mapping;
+    }
+    if (errno != EEXIST)
+    {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + name);
+    }
+
+    FileDescriptor const fd(OpenSegment(name, O_RDONLY, false));
+    if (fd.Get() < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Failed to open " + name);
+    }
+    auto const mapping = Attach(fd.Get(), name, expected);
+    if (!mapping)
+    {
+        throw std::runtime_error("Timed out waiting for " + name + " to be built");
+    }
+    return *mapping;
+}
+} // namespace
+
+SharedLookupTable::SharedLookupTable(std::string const& name)
+{
+    // Every process has to end up with the same copy. A process that creates the huge page segment
+    // gives it up if an ordinary one already exists, and one that can't back the table with huge
+    // pages creates the ordinary segment before removing the huge page one. A process attaching to
+    // a huge page segment that is removed or can't be mapped follows it to the ordinary one.
+    Header expected{};
+    expected.magic_ = headerMagic;
+    expected.version_ = headerVersion;
+    expected.ready_ = 0;
+    expected.decimationRate_ = Filter::decimationRate_;
+    expected.filterLength_ = Filter::filterLength_;
+    expected.samplesPerLookupTableStep_ = Filter::samplesPerLookupTableStep_;
+    expected.kaiserWindowBeta_ = Filter::kaiserWindowBeta_;
+    expected.lookupTableSize_ = Filter::lookupTableSize;
+
+    auto const buildTable = [](std::byte* const address) {
+        Filter::BuildLookupTable(*new (address) Filter::LookupTableType);
+    };
+
+    auto const hugePagePath = hugePageDirectory + name;
+    std::size_t const size = tableOffset + Filter::lookupTableSize;
+    std::size_t const hugePageMappingSize
+        = ((size + hugePageSize - 1) / hugePageSize) * hugePageSize;
+
+    std::optional<Mapping> mapping;
+    bool removeHugePageSegment = false;
+
+    int const created = OpenSegment(hugePagePath, O_RDWR | O_CREAT | O_EXCL, true);
+    if (created >= 0)
+    {
+        FileDescriptor const fd(created);
+        if (!SegmentExists(name, false))
+        {
+            mapping = Create(fd.Get(), hugePageMappingSize, expected, buildTable);
+        }
+        removeHugePageSegment = !mapping;
+    }
+    else if (errno == EEXIST)
+    {
+        FileDescriptor const fd(OpenSegment(hugePagePath, O_RDONLY, true));
+        if (fd.Get() >= 0)
+        {
+            mapping = Attach(fd.Get(), hugePagePath, expected);
+        }
+    }
+
+    if (mapping)
+    {
+        hugePages_ = true;
+    }
+    else
+    {
+        try
+        {
+            mapping = OpenOrdinary(name, expected, buildTable);
+        }
+        catch (...)
+        {
+            if (removeHugePageSegment)
+            {
+                RemoveSegment(hugePagePath, true);
+            }
+            throw;
+        }
+        if (removeHugePageSegment)
+        {
+            RemoveSegment(hugePagePath, true);
+        }
+    }
+
+    mapping_ = mapping->address_;
+    mappingSize_ = mapping->size_;
+}
+
+SharedLookupTable::~SharedLookupTable()
+{
+    ::munmap(mapping_, mappingSize_);
+}
+
+auto SharedLookupTable::Table() const -> Filter::LookupTableType const&
+{
+    auto const* const table = static_cast<std::byte const*>(mapping_) + tableOffset;
+    return *std::launder(reinterpret_cast<Filter::LookupTableType const*>(table));
+}
+
+auto SharedLookupTable::UsesHugePages() const -> bool
+{
+    return hugePages_;
+}
+
+void SharedLookupTable::Remove(std::string const& name)
+{
+    RemoveSegment(hugePageDirectory + name, true);
+    RemoveSegment(name, false);
+}
+} // namespace PdmToPcm
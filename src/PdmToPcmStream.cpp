@@ -0,0 +1,51 @@
+#include "PdmToPcmStream.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace PdmToPcm
+{
+BlockStream::BlockStream(Filter& filter, std::span<int32_t> const block)
+    : filter_(filter)
+    , block_(block)
+{
+}
+
+void BlockStream::Feed(std::span<uint8_t const> const dataIn)
+{
+    input_ = dataIn;
+}
+
+auto BlockStream::Next() -> std::optional<std::span<int32_t const>>
+{
+    if (block_.empty())
+    {
+        return std::nullopt;
+    }
+
+    auto const result = filter_.Process(input_, block_.subspan(blockFilled_));
+    input_ = input_.subspan(result.inputConsumed_);
+    inputConsumed_ += result.inputConsumed_;
+    blockFilled_ += result.outputWritten_;
+
+    // Either the block is full or the input has run out, in both cases it's over to the caller.
+    if (blockFilled_ == block_.size())
+    {
+        blockFilled_ = 0;
+        return block_;
+    }
+
+    return std::nullopt;
+}
+
+auto BlockStream::Remaining() const -> std::span<uint8_t const>
+{
+    return input_;
+}
+
+auto BlockStream::InputConsumed() const -> std::size_t
+{
+    return inputConsumed_;
+}
+} // namespace PdmToPcm
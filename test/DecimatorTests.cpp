@@ -0,0 +1,97 @@
+#include "Filters.hpp"
+#include "PdmToPcm.hpp"
+#include "PdmToPcmDecimator.hpp"
+#include "TestInput.hpp"
+#include "Windows.hpp"
+#include "gtest/gtest.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t decimationRate = 72;
+constexpr std::size_t kernelLength = 8 * decimationRate;
+} // namespace
+
+TEST(DecimatorTests, FftMatchesLookupTable)
+{
+    auto const kernel
+        = Filters::LowPass(Windows::Kaiser<kernelLength>(5.4), 0.5 / decimationRate);
+    auto const dataIn = TestInput::SigmaDeltaSine(9 * 2000);
+
+    PdmToPcm::LookupTableFilter lookupTable(kernel, decimationRate);
+    std::vector<int32_t> expected(2000);
+    ASSERT_EQ(lookupTable.Process(dataIn, expected).outputWritten_, expected.size());
+
+    // The FFT engine only produces output a block at a time so feed it in pieces and gather up
+    // whatever comes out.
+    PdmToPcm::FftFilter fft(kernel, decimationRate);
+    std::vector<int32_t> actual;
+    std::span<uint8_t const> in(dataIn);
+    while (!in.empty())
+    {
+        std::array<int32_t, 7> out{};
+        auto const result = fft.Process(in.first(std::min<std::size_t>(in.size(), 100)), out);
+        in = in.subspan(result.inputConsumed_);
+        actual.insert(actual.end(), out.begin(), out.begin() + result.outputWritten_);
+    }
+
+    ASSERT_GT(actual.size(), expected.size() / 2);
+    // Each of the 72 table rows is rounded to the nearest integer.
+    constexpr int32_t tolerance = kernelLength / 8 / 2;
+    for (std::size_t i = 0; i < actual.size(); ++i)
+    {
+        ASSERT_NEAR(expected.at(i), actual.at(i), tolerance);
+    }
+}
+
+TEST(DecimatorTests, SwitchesEngineAtThreshold)
+{
+    auto const kernel
+        = Filters::LowPass(Windows::Kaiser<kernelLength>(5.4), 0.5 / decimationRate);
+
+    PdmToPcm::Decimator const below(kernel, decimationRate, kernelLength);
+    ASSERT_FALSE(below.UsesFft());
+
+    PdmToPcm::Decimator const above(kernel, decimationRate, kernelLength - 1);
+    ASSERT_TRUE(above.UsesFft());
+}
+
+TEST(DecimatorTests, LookupTableFilterMatchesFilter)
+{
+    // The kernel Filter builds its table from.
+    constexpr std::size_t filterLength = 1368;
+    auto const kernel
+        = Filters::LowPass(Windows::Kaiser<filterLength>(5.4), 0.5 / decimationRate);
+    auto const dataIn = TestInput::SigmaDeltaSine(9 * 500);
+
+    PdmToPcm::Filter reference;
+    std::vector<int32_t> expected(500);
+    ASSERT_EQ(reference.Process(dataIn, expected).outputWritten_, expected.size());
+
+    PdmToPcm::LookupTableFilter lookupTable(kernel, decimationRate);
+    std::vector<int32_t> actual(500);
+    ASSERT_EQ(lookupTable.Process(dataIn, actual).outputWritten_, actual.size());
+
+    ASSERT_EQ(actual, expected);
+}
+
+TEST(DecimatorTests, RejectsKernelThatDoesNotFitDecimationRate)
+{
+    std::vector<double> const kernel(64, 1.0 / 64);
+
+    // 64 taps is not a whole number of banks at a decimation rate of 48.
+    ASSERT_THROW(PdmToPcm::LookupTableFilter(kernel, 48), std::invalid_argument);
+    ASSERT_THROW(PdmToPcm::FftFilter(kernel, 48), std::invalid_argument);
+
+    // A decimation rate of 4 would finish outputs part way through a byte.
+    ASSERT_THROW(PdmToPcm::LookupTableFilter(kernel, 4), std::invalid_argument);
+    ASSERT_THROW(PdmToPcm::FftFilter(kernel, 4), std::invalid_argument);
+
+    ASSERT_THROW(PdmToPcm::LookupTableFilter(kernel, 0), std::invalid_argument);
+    ASSERT_THROW(PdmToPcm::LookupTableFilter(std::vector<double>{}, 8), std::invalid_argument);
+    ASSERT_NO_THROW(PdmToPcm::LookupTableFilter(kernel, 8));
+}
@@ -1,8 +1,475 @@
+#include "Filters.hpp"
 #include "PdmToPcm.hpp"
+#include "PdmToPcmDecimator.hpp"
+#include "PdmToPcmMultiRate.hpp"
+#include "PdmToPcmStream.hpp"
+#include "Windows.hpp"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <vector>
 
 TEST(PdmToPcmTests, TestOne)
 {
     constexpr auto sampleRate = 2e6;
     
-}
\ No newline at end of file
+}
+
+TEST(PdmToPcmTests, ProcessReportsInputConsumed)
+{
+    // The filter produces one output for every 9 input bytes, so with room for 5 outputs only the
+    // first 45 bytes should be used.
+    PdmToPcm::Filter filter;
+    std::array<uint8_t, 100> dataIn{};
+    std::array<int32_t, 5> dataOut{};
+
+    auto const result = filter.Process(dataIn, dataOut);
+    ASSERT_EQ(result.inputConsumed_, 45);
+    ASSERT_EQ(result.outputWritten_, 5);
+
+    auto const rest = filter.Process(std::span(dataIn).subspan(result.inputConsumed_), dataOut);
+    ASSERT_EQ(rest.inputConsumed_, 45);
+    ASSERT_EQ(rest.outputWritten_, 5);
+}
+
+TEST(PdmToPcmTests, BlockStreamMatchesApply)
+{
+    constexpr std::size_t inputLength = 1000;
+    constexpr std::size_t blockLength = 16;
+
+    std::vector<uint8_t> dataIn(inputLength);
+    for (std::size_t i = 0; i < inputLength; ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 37U) ^ (i >> 3U));
+    }
+
+    PdmToPcm::Filter reference;
+    std::vector<int32_t> expected(inputLength);
+    expected.resize(reference.Apply(dataIn, expected));
+
+    PdmToPcm::Filter filter;
+    std::array<int32_t, blockLength> block{};
+    PdmToPcm::BlockStream stream(filter, block);
+    std::vector<int32_t> actual;
+
+    // Feed the input in awkwardly sized pieces so blocks straddle the feeds.
+    constexpr std::size_t feedLength = 77;
+    for (std::size_t offset = 0; offset < inputLength; offset += feedLength)
+    {
+        stream.Feed(std::span(dataIn).subspan(offset, std::min(feedLength, inputLength - offset)));
+        while (auto const output = stream.Next())
+        {
+            actual.insert(actual.end(), output->begin(), output->end());
+        }
+        ASSERT_TRUE(stream.Remaining().empty());
+    }
+
+    ASSERT_EQ(stream.InputConsumed(), inputLength);
+    ASSERT_EQ(actual.size(), (expected.size() / blockLength) * blockLength);
+    for (std::size_t i = 0; i < actual.size(); ++i)
+    {
+        ASSERT_EQ(expected.at(i), actual.at(i));
+    }
+}
+
+namespace
+{
+template <std::size_t outputLength>
+void ExpectFixedBlockApplyMatchesProcess(std::size_t const leadIn)
+{
+    constexpr std::size_t numberOfBlocks = 7;
+    using InputBlock = PdmToPcm::Filter::InputBlock<outputLength>;
+    using OutputBlock = PdmToPcm::Filter::OutputBlock<outputLength>;
+
+    std::vector<uint8_t> dataIn(leadIn + numberOfBlocks * sizeof(InputBlock));
+    for (std::size_t i = 0; i < dataIn.size(); ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 151U) ^ (i >> 2U));
+    }
+
+    // A lead in that isn't a multiple of 9 bytes leaves the filter part way between outputs.
+    PdmToPcm::Filter reference;
+    PdmToPcm::Filter filter;
+    std::array<int32_t, 1> unused{};
+    reference.Process(std::span(dataIn).first(leadIn), unused);
+    filter.Process(std::span(dataIn).first(leadIn), unused);
+
+    std::vector<int32_t> expected(numberOfBlocks * outputLength);
+    reference.Process(std::span(dataIn).subspan(leadIn), expected);
+
+    for (std::size_t block = 0; block < numberOfBlocks; ++block)
+    {
+        InputBlock in{};
+        std::copy_n(dataIn.begin() + leadIn + block * in.size(), in.size(), in.begin());
+        OutputBlock out{};
+        filter.Apply(in, out);
+        for (std::size_t i = 0; i < outputLength; ++i)
+        {
+            ASSERT_EQ(expected.at(block * outputLength + i), out.at(i));
+        }
+    }
+}
+} // namespace
+
+TEST(PdmToPcmTests, FixedBlockApplyMatchesProcess)
+{
+    ExpectFixedBlockApplyMatchesProcess<1>(0);
+    ExpectFixedBlockApplyMatchesProcess<45>(0);
+    ExpectFixedBlockApplyMatchesProcess<45>(4);
+    ExpectFixedBlockApplyMatchesProcess<64>(18);
+}
+
+TEST(PdmToPcmTests, MultiRateFilterSharesFirstStage)
+{
+    constexpr std::size_t inputLength = 9 * 300;
+    constexpr auto decimationRate = PdmToPcm::MultiRateFilter::secondStageDecimationRate_;
+
+    std::vector<uint8_t> dataIn(inputLength);
+    for (std::size_t i = 0; i < inputLength; ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 91U) ^ (i >> 4U));
+    }
+
+    PdmToPcm::Filter reference;
+    std::vector<int32_t> expected(inputLength);
+    expected.resize(reference.Apply(dataIn, expected));
+
+    // Run once in one go and once in small uneven pieces, the outputs should be identical.
+    PdmToPcm::MultiRateFilter whole;
+    std::vector<int32_t> wholeOut(expected.size());
+    std::vector<int32_t> wholeOutDecimated(expected.size() / decimationRate);
+    auto const wholeResult = whole.Process(dataIn, wholeOut, wholeOutDecimated);
+    ASSERT_EQ(wholeResult.inputConsumed_, inputLength);
+    ASSERT_EQ(wholeResult.outputWritten_, expected.size());
+    ASSERT_EQ(wholeResult.decimatedOutputWritten_, expected.size() / decimationRate);
+    ASSERT_EQ(wholeOut, expected);
+
+    // The second stage on its own: a direct FIR over the Filter output, kept every third sample.
+    // The kernel is built the same way, a Kaiser windowed low pass with unity gain at DC in Q15.
+    constexpr std::size_t secondStageLength = 96;
+    auto const prototype = Filters::LowPass(
+        Windows::Kaiser<secondStageLength>(5.4),
+        0.9 * 0.5 / static_cast<double>(decimationRate));
+    double gain = 0.0;
+    for (auto const coefficient : prototype)
+    {
+        gain += coefficient;
+    }
+    std::array<int64_t, secondStageLength> kernel{};
+    for (std::size_t i = 0; i < secondStageLength; ++i)
+    {
+        kernel.at(i) = std::lround(32768.0 * prototype.at(i) / gain);
+    }
+
+    std::vector<int32_t> expectedDecimated;
+    for (std::size_t n = decimationRate - 1; n < expected.size(); n += decimationRate)
+    {
+        int64_t sum = 0;
+        for (std::size_t j = 0; j < secondStageLength && j <= n; ++j)
+        {
+            sum += kernel.at(j) * expected[n - j];
+        }
+        expectedDecimated.push_back(static_cast<int32_t>(sum >> 15));
+    }
+    ASSERT_EQ(wholeOutDecimated, expectedDecimated);
+
+    PdmToPcm::MultiRateFilter pieces;
+    std::vector<int32_t> piecesOut;
+    std::vector<int32_t> piecesOutDecimated;
+    std::span<uint8_t const> in(dataIn);
+    while (!in.empty())
+    {
+        std::array<int32_t, 5> out{};
+        std::array<int32_t, 1> outDecimated{};
+        auto const result
+            = pieces.Process(in.first(std::min<std::size_t>(in.size(), 50)), out, outDecimated);
+        in = in.subspan(result.inputConsumed_);
+        piecesOut.insert(piecesOut.end(), out.begin(), out.begin() + result.outputWritten_);
+        piecesOutDecimated.insert(
+            piecesOutDecimated.end(),
+            outDecimated.begin(),
+            outDecimated.begin() + result.decimatedOutputWritten_);
+    }
+    ASSERT_EQ(piecesOut, expected);
+    ASSERT_EQ(piecesOutDecimated, wholeOutDecimated);
+}
+
+TEST(PdmToPcmTests, LevelsMatchOutput)
+{
+    constexpr std::size_t inputLength = 9 * 500;
+
+    std::vector<uint8_t> dataIn(inputLength);
+    for (std::size_t i = 0; i < inputLength; ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 73U) ^ (i >> 5U));
+    }
+
+    PdmToPcm::Filter reference;
+    std::vector<int32_t> expected(inputLength);
+    expected.resize(reference.Apply(dataIn, expected));
+
+    int32_t peak = 0;
+    uint64_t sumOfSquares = 0;
+    for (auto const sample : expected)
+    {
+        peak = std::max(peak, std::abs(sample));
+        sumOfSquares += static_cast<uint64_t>(static_cast<int64_t>(sample) * sample);
+    }
+
+    // Clip at the peak so the count is known.
+    PdmToPcm::Filter filter;
+    PdmToPcm::Filter::Levels levels{.clipLevel_ = std::max(peak, 1)};
+    std::vector<int32_t> actual(expected.size());
+    auto const first = filter.Process(dataIn, std::span(actual).first(100), levels);
+    filter.Process(
+        std::span(dataIn).subspan(first.inputConsumed_),
+        std::span(actual).subspan(100),
+        levels);
+
+    ASSERT_EQ(actual, expected);
+    ASSERT_EQ(levels.sampleCount_, expected.size());
+    ASSERT_EQ(levels.peak_, peak);
+    ASSERT_EQ(levels.sumOfSquares_, sumOfSquares);
+    auto const clipCount = std::count_if(
+        expected.begin(),
+        expected.end(),
+        [&](auto const sample) { return std::abs(sample) >= levels.clipLevel_; });
+    ASSERT_EQ(levels.clipCount_, static_cast<std::size_t>(clipCount));
+
+    levels.Reset();
+    ASSERT_EQ(levels.sampleCount_, 0);
+    ASSERT_FALSE(levels.Active(1.0));
+}
+
+TEST(PdmToPcmTests, LevelsMatchOutputInFixedBlocks)
+{
+    constexpr std::size_t blockLength = 25;
+    constexpr std::size_t numberOfBlocks = 20;
+    constexpr std::size_t blockBytes = blockLength * 9;
+    // A few bytes fed through Process() part way through leave later blocks out of phase.
+    constexpr std::size_t strayBytes = 4;
+
+    // Busy input that turns idle, so the unrolled, out of phase and replayed paths are all
+    // metered.
+    std::vector<uint8_t> dataIn(blockBytes * numberOfBlocks + strayBytes, 0x55);
+    for (std::size_t i = 0; i < dataIn.size() / 2; ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 73U) ^ (i >> 5U));
+    }
+
+    PdmToPcm::Filter reference;
+    std::vector<int32_t> expected(dataIn.size());
+    expected.resize(reference.Apply(dataIn, expected));
+    ASSERT_EQ(expected.size(), blockLength * numberOfBlocks);
+
+    int32_t peak = 0;
+    uint64_t sumOfSquares = 0;
+    for (auto const sample : expected)
+    {
+        peak = std::max(peak, std::abs(sample));
+        sumOfSquares += static_cast<uint64_t>(static_cast<int64_t>(sample) * sample);
+    }
+
+    PdmToPcm::Filter filter;
+    PdmToPcm::Filter::Levels levels{.clipLevel_ = std::max(peak, 1)};
+    std::vector<int32_t> actual;
+    std::span<uint8_t const> in(dataIn);
+    for (std::size_t block = 0; block < numberOfBlocks; ++block)
+    {
+        if (block == numberOfBlocks / 4)
+        {
+            std::array<int32_t, 1> none{};
+            ASSERT_EQ(filter.Process(in.first(strayBytes), none, levels).outputWritten_, 0);
+            in = in.subspan(strayBytes);
+        }
+
+        PdmToPcm::Filter::InputBlock<blockLength> blockIn{};
+        std::copy_n(in.begin(), blockBytes, blockIn.begin());
+        in = in.subspan(blockBytes);
+        PdmToPcm::Filter::OutputBlock<blockLength> blockOut{};
+        filter.Apply<blockLength>(blockIn, blockOut, levels);
+        actual.insert(actual.end(), blockOut.begin(), blockOut.end());
+    }
+
+    ASSERT_EQ(actual, expected);
+    ASSERT_EQ(levels.sampleCount_, expected.size());
+    ASSERT_EQ(levels.peak_, peak);
+    ASSERT_EQ(levels.sumOfSquares_, sumOfSquares);
+    auto const clipCount = std::count_if(
+        expected.begin(),
+        expected.end(),
+        [&](auto const sample) { return std::abs(sample) >= levels.clipLevel_; });
+    ASSERT_EQ(levels.clipCount_, static_cast<std::size_t>(clipCount));
+}
+
+TEST(PdmToPcmTests, AccessOrderLayoutMatchesStepMajor)
+{
+    constexpr std::size_t inputLength = 9 * 300 + 5;
+
+    std::vector<uint8_t> dataIn(inputLength);
+    for (std::size_t i = 0; i < inputLength; ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 151U) ^ (i >> 3U));
+    }
+
+    PdmToPcm::Filter stepMajor(PdmToPcm::Filter::LookupTableLayout::StepMajor);
+    std::vector<int32_t> expected(inputLength);
+    expected.resize(stepMajor.Apply(dataIn, expected));
+
+    // Uneven pieces so calls stop part way between outputs.
+    PdmToPcm::Filter accessOrder(PdmToPcm::Filter::LookupTableLayout::AccessOrder);
+    std::vector<int32_t> actual;
+    std::span<uint8_t const> in = dataIn;
+    std::array<int32_t, 7> dataOut{};
+    for (std::size_t piece = 1; !in.empty(); piece = piece % 23 + 4)
+    {
+        auto const result = accessOrder.Process(in.first(std::min(piece, in.size())), dataOut);
+        actual.insert(actual.end(), dataOut.begin(), dataOut.begin() + result.outputWritten_);
+        in = in.subspan(result.inputConsumed_);
+    }
+
+    ASSERT_EQ(actual, expected);
+}
+
+namespace
+{
+// Stretches of repeating patterns, with periods of 1, 2 and 3 bytes, between noise. Some are too
+// short to be taken as idle.
+auto CreateMostlyIdleInput() -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> dataIn;
+    uint32_t state = 1;
+    auto const addNoise = [&](std::size_t const length) {
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            state = state * 1664525U + 1013904223U;
+            dataIn.push_back(static_cast<uint8_t>(state >> 24U));
+        }
+    };
+    auto const addPattern = [&](std::vector<uint8_t> const& pattern, std::size_t const length) {
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            dataIn.push_back(pattern[i % pattern.size()]);
+        }
+    };
+    addNoise(500);
+    addPattern({0x55}, 2000);
+    addNoise(7);
+    addPattern({0xAA}, 150);
+    addNoise(300);
+    addPattern({0x69, 0x96}, 1001);
+    addPattern({0x92, 0x49, 0x24}, 1500);
+    addPattern({0x55}, 400);
+    addNoise(1);
+    addPattern({0x55}, 700);
+    addNoise(400);
+    return dataIn;
+}
+
+// The runtime lookup table engine has no idle handling but the same table as Filter.
+auto DecimateWithoutIdle(std::span<uint8_t const> const dataIn) -> std::vector<int32_t>
+{
+    auto const kernel = Filters::LowPass(Windows::Kaiser<1368>(5.4), 0.5 / 72);
+    PdmToPcm::LookupTableFilter reference(kernel, 72);
+    std::vector<int32_t> dataOut(dataIn.size());
+    dataOut.resize(reference.Process(dataIn, dataOut).outputWritten_);
+    return dataOut;
+}
+
+constexpr std::array lookupTableLayouts = {
+    PdmToPcm::Filter::LookupTableLayout::StepMajor,
+    PdmToPcm::Filter::LookupTableLayout::AccessOrder};
+} // namespace
+
+TEST(PdmToPcmTests, IdleInputMatchesFullFilter)
+{
+    auto const dataIn = CreateMostlyIdleInput();
+    auto const expected = DecimateWithoutIdle(dataIn);
+
+    for (auto const layout : lookupTableLayouts)
+    {
+        PdmToPcm::Filter filter(layout);
+        PdmToPcm::Filter::Levels levels;
+        std::vector<int32_t> actual;
+        std::span<uint8_t const> in = dataIn;
+        std::array<int32_t, 11> dataOut{};
+        for (std::size_t piece = 5; !in.empty(); piece = piece % 257 + 40)
+        {
+            auto const result
+                = filter.Process(in.first(std::min(piece, in.size())), dataOut, levels);
+            actual.insert(actual.end(), dataOut.begin(), dataOut.begin() + result.outputWritten_);
+            in = in.subspan(result.inputConsumed_);
+        }
+
+        ASSERT_EQ(actual, expected);
+        ASSERT_EQ(levels.sampleCount_, expected.size());
+    }
+}
+
+TEST(PdmToPcmTests, IdleInputMatchesFullFilterWithSmallBuffers)
+{
+    // Room for only a few outputs makes most calls stop part way between outputs, and small
+    // pieces leave idle blocks unfinished at the end of a call.
+    auto const dataIn = CreateMostlyIdleInput();
+    auto const expected = DecimateWithoutIdle(dataIn);
+
+    for (uint32_t seed = 0; seed < 40; ++seed)
+    {
+        PdmToPcm::Filter filter(lookupTableLayouts.at(seed % lookupTableLayouts.size()));
+        std::vector<int32_t> actual;
+        std::span<uint8_t const> in = dataIn;
+        std::array<int32_t, 4> dataOut{};
+        uint32_t state = seed;
+        while (!in.empty())
+        {
+            state = state * 1664525U + 1013904223U;
+            auto const piece = std::min<std::size_t>(1 + (state >> 26U), in.size());
+            auto const room = 1 + ((state >> 8U) % dataOut.size());
+
+            auto const result = filter.Process(in.first(piece), std::span(dataOut).first(room));
+            actual.insert(actual.end(), dataOut.begin(), dataOut.begin() + result.outputWritten_);
+            in = in.subspan(result.inputConsumed_);
+        }
+
+        ASSERT_EQ(actual, expected) << seed;
+    }
+}
+
+TEST(PdmToPcmTests, IdleInputMatchesFullFilterInFixedBlocks)
+{
+    constexpr std::size_t blockLength = 5;
+    auto const dataIn = CreateMostlyIdleInput();
+    auto expected = DecimateWithoutIdle(dataIn);
+
+    PdmToPcm::Filter filter;
+    std::vector<int32_t> actual;
+    std::span<uint8_t const> in = dataIn;
+
+    // Start part way between outputs now and again, to move the blocks around.
+    std::size_t blocks = 0;
+    while (in.size() >= PdmToPcm::Filter::InputBlock<blockLength>().size() + 4)
+    {
+        if (++blocks % 50 == 0)
+        {
+            std::array<int32_t, 1> dataOut{};
+            auto const result = filter.Process(in.first(4), dataOut);
+            actual.insert(actual.end(), dataOut.begin(), dataOut.begin() + result.outputWritten_);
+            in = in.subspan(result.inputConsumed_);
+        }
+
+        PdmToPcm::Filter::InputBlock<blockLength> block{};
+        std::copy_n(in.begin(), block.size(), block.begin());
+        PdmToPcm::Filter::OutputBlock<blockLength> dataOut{};
+        filter.Apply(block, dataOut);
+        actual.insert(actual.end(), dataOut.begin(), dataOut.end());
+        in = in.subspan(block.size());
+    }
+
+    expected.resize(actual.size());
+    ASSERT_EQ(actual, expected);
+}
@@ -0,0 +1,107 @@
+#include "PdmToPcm.hpp"
+#include "PdmToPcmReconfigurable.hpp"
+#include "TestInput.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace
+{
+auto Decimate(PdmToPcm::Filter& filter, std::span<uint8_t const> const dataIn)
+    -> std::vector<int32_t>
+{
+    std::vector<int32_t> dataOut(dataIn.size());
+    dataOut.resize(filter.Process(dataIn, dataOut).outputWritten_);
+    return dataOut;
+}
+} // namespace
+
+TEST(ReconfigurableFilterTests, MatchesFilterUntilReconfigured)
+{
+    auto const dataIn = TestInput::SigmaDeltaSine(9 * 300);
+
+    PdmToPcm::Filter filter;
+    auto const expected = Decimate(filter, dataIn);
+
+    PdmToPcm::ReconfigurableFilter reconfigurable;
+    std::vector<int32_t> actual(expected.size());
+    auto const result = reconfigurable.Process(dataIn, actual);
+
+    ASSERT_EQ(result.outputWritten_, expected.size());
+    ASSERT_EQ(actual, expected);
+}
+
+namespace
+{
+// Switches to a narrower table after the first switchAfter bytes of input.
+void ExpectCrossfade(std::span<uint8_t const> const dataIn, std::size_t const switchAfter)
+{
+    constexpr std::size_t crossfadeLength = 32;
+    constexpr std::size_t warmUpLength = 19;
+
+    // Voice band only, at 3.072 MHz a quarter of the usual cutoff is about 5 kHz.
+    PdmToPcm::FilterTable const voice(0.125 / 72);
+
+    PdmToPcm::Filter oldFilter;
+    auto const oldOut = Decimate(oldFilter, dataIn);
+    PdmToPcm::Filter newFilter(voice);
+    auto const newOut = Decimate(newFilter, dataIn);
+
+    PdmToPcm::ReconfigurableFilter reconfigurable(crossfadeLength);
+    std::vector<int32_t> actual(oldOut.size());
+    std::span<uint8_t const> in(dataIn);
+    std::span<int32_t> out(actual);
+
+    auto const first = reconfigurable.Process(in.first(switchAfter), out);
+    in = in.subspan(first.inputConsumed_);
+    out = out.subspan(first.outputWritten_);
+    std::size_t const switchedAt = first.outputWritten_;
+
+    reconfigurable.Reconfigure(voice);
+    while (!in.empty())
+    {
+        auto const result
+            = reconfigurable.Process(in.first(std::min<std::size_t>(in.size(), 37)), out);
+        in = in.subspan(result.inputConsumed_);
+        out = out.subspan(result.outputWritten_);
+    }
+    ASSERT_FALSE(reconfigurable.Switching());
+    ASSERT_TRUE(out.empty());
+
+    for (std::size_t i = 0; i < actual.size(); ++i)
+    {
+        if (i < switchedAt + warmUpLength)
+        {
+            ASSERT_EQ(actual[i], oldOut[i]) << i;
+        }
+        else if (i >= switchedAt + warmUpLength + crossfadeLength - 1)
+        {
+            ASSERT_EQ(actual[i], newOut[i]) << i;
+        }
+        else
+        {
+            ASSERT_GE(actual[i], std::min(oldOut[i], newOut[i])) << i;
+            ASSERT_LE(actual[i], std::max(oldOut[i], newOut[i])) << i;
+        }
+    }
+}
+} // namespace
+
+TEST(ReconfigurableFilterTests, CrossfadesToNewTable)
+{
+    // Switch part way between two outputs.
+    ExpectCrossfade(TestInput::SigmaDeltaSine(9 * 400), 9 * 50 + 4);
+}
+
+TEST(ReconfigurableFilterTests, CrossfadesToNewTableWhileIdle)
+{
+    // The switch comes part way through an idle block, while the banks are still where the block
+    // began.
+    auto dataIn = TestInput::SigmaDeltaSine(9 * 30);
+    dataIn.resize(9 * 400, 0x55);
+    ExpectCrossfade(dataIn, 9 * 100 + 4);
+}
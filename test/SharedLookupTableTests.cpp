@@ -0,0 +1,101 @@
+#include "PdmToPcm.hpp"
+#include "PdmToPcmShared.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+auto UniqueName(std::string const& test) -> std::string
+{
+    return "/pdm_to_pcm_test_" + test + "_" + std::to_string(::getpid());
+}
+} // namespace
+
+TEST(SharedLookupTableTests, FiltersShareOneTable)
+{
+    auto const name = UniqueName("share");
+    PdmToPcm::SharedLookupTable::Remove(name);
+
+    PdmToPcm::SharedLookupTable const creator(name);
+    PdmToPcm::SharedLookupTable const attached(name);
+    ASSERT_NE(&creator.Table(), &attached.Table());
+
+    // Equal tables could still be two private copies. A change made through a separate, writable
+    // mapping of the named segment shows up in both only if both map that segment.
+    auto const path = creator.UsesHugePages() ? "/dev/hugepages" + name : name;
+    int const fd = creator.UsesHugePages() ? ::open(path.c_str(), O_RDWR)
+                                           : ::shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_GE(fd, 0);
+    struct stat status{};
+    ASSERT_EQ(::fstat(fd, &status), 0);
+    auto const size = static_cast<std::size_t>(status.st_size);
+    void* const mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    ASSERT_NE(mapping, MAP_FAILED);
+
+    auto* const segment = static_cast<std::byte*>(mapping);
+    auto const* const table = reinterpret_cast<std::byte const*>(&creator.Table());
+    auto* const entry
+        = std::search(segment, segment + size, table, table + sizeof(creator.Table()));
+    ASSERT_NE(entry, segment + size);
+
+    auto const original = *entry;
+    *entry = ~original;
+    auto const creatorSees = *reinterpret_cast<std::byte const*>(&creator.Table());
+    auto const attachedSees = *reinterpret_cast<std::byte const*>(&attached.Table());
+    *entry = original;
+    ::munmap(mapping, size);
+    ASSERT_EQ(creatorSees, ~original);
+    ASSERT_EQ(attachedSees, ~original);
+
+    std::vector<uint8_t> dataIn(9 * 200);
+    for (std::size_t i = 0; i < dataIn.size(); ++i)
+    {
+        dataIn[i] = static_cast<uint8_t>((i * 29U) ^ (i >> 3U));
+    }
+
+    PdmToPcm::Filter reference;
+    std::vector<int32_t> expected(200);
+    reference.Process(dataIn, expected);
+
+    PdmToPcm::Filter filter(attached);
+    std::vector<int32_t> actual(200);
+    filter.Process(dataIn, actual);
+
+    ASSERT_EQ(actual, expected);
+
+    PdmToPcm::SharedLookupTable::Remove(name);
+}
+
+TEST(SharedLookupTableTests, RefusesMismatchedTable)
+{
+    auto const name = UniqueName("mismatch");
+    PdmToPcm::SharedLookupTable::Remove(name);
+
+    // A segment that is finished but has the wrong magic number. An ordinary segment is taken in
+    // preference to creating a huge page one, so this is what gets opened either way.
+    int const fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GE(fd, 0);
+    constexpr std::size_t size = 1U << 20U;
+    ASSERT_EQ(::ftruncate(fd, size), 0);
+    void* const mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT_NE(mapping, MAP_FAILED);
+    auto* const words = static_cast<uint32_t*>(mapping);
+    words[0] = 0xdeadbeef;
+    words[2] = 1;
+    ::munmap(mapping, size);
+    ::close(fd);
+
+    ASSERT_THROW(PdmToPcm::SharedLookupTable{name}, std::runtime_error);
+
+    PdmToPcm::SharedLookupTable::Remove(name);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TestInput
+{
+// A crude first order sigma delta modulation of a slow sine wave, length bytes long. Starting delay
+// samples late, with zeros before, gives the same signal as heard by a further microphone.
+inline auto SigmaDeltaSine(std::size_t const length, std::size_t const delay = 0)
+    -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> data(length);
+    double error = 0.0;
+    for (std::size_t i = 0; i < length * 8 - delay; ++i)
+    {
+        double const x = 0.5 * std::sin(static_cast<double>(i) * 1e-3);
+        auto const bit = (x - error) >= 0.0 ? 1U : 0U;
+        error += (bit != 0 ? 1.0 : -1.0) - x;
+        auto const sample = i + delay;
+        data[sample / 8] |= static_cast<uint8_t>(bit << (7 - (sample % 8)));
+    }
+    return data;
+}
+} // namespace TestInput